@@ -0,0 +1,190 @@
+﻿//无界面的csv批处理工具，只依赖数据层，可在Linux下编译：
+//g++ -std=c++17 -O2 -pthread batch/csvbatch.cpp -o csvbatch
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<vector>
+#include<unordered_set>
+#include<chrono>
+#include"../framework/csvfile.h"
+#include"../framework/schema.h"
+using namespace std;
+
+//通用行记录，按字段保存，不关心具体类型
+class CsvRow : public ISerializable<CsvRow>
+{
+public:
+	vector<string> fields;
+	static size_t expected;  //要求的字段数，0表示不检查
+
+	string ToCsvRow() override
+	{
+		string row;
+		AppendCsvRow(row);
+		return row;
+	}
+	void AppendCsvRow(string& out) override
+	{
+		for (size_t i = 0; i < fields.size(); i++)
+		{
+			if (i > 0) out += ',';
+			SchemaCodec::AppendCsv(out, fields[i]);
+		}
+	}
+	void FromCsvRow(string str) override
+	{
+		fields.clear();
+		CsvCursor cursor(str);
+		string_view field;
+		while (cursor.Next(field)) fields.emplace_back(field);
+		if (expected != 0 && fields.size() != expected)
+			throw invalid_argument("字段数为" + to_string(fields.size()) + "，应为" + to_string(expected));
+	}
+};
+size_t CsvRow::expected = 0;
+
+//进度与吞吐量，输出到stderr
+class Progress
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	chrono::steady_clock::time_point last = start;
+	uintmax_t bytes = 0;
+public:
+	size_t rows = 0;
+	size_t errors = 0;
+
+	double Seconds()
+	{
+		return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+	//每块读完时调用，最多每秒输出一次
+	void Update(uintmax_t done, uintmax_t total)
+	{
+		bytes = done;
+		auto now = chrono::steady_clock::now();
+		if (now - last < chrono::seconds(1) && done < total) return;
+		last = now;
+		double s = max(Seconds(), 1e-6);
+		fprintf(stderr, "\r%5.1f%%  %zu行  %.1f MB/s  %.0f行/s", total == 0 ? 100.0 : done * 100.0 / total, rows, bytes / s / 1048576, rows / s);
+		fflush(stderr);
+	}
+	void Summary(const char* action)
+	{
+		double s = max(Seconds(), 1e-6);
+		fprintf(stderr, "\n%s完成：%zu行，%zu个错误，%.2f秒，%.1f MB/s\n", action, rows, errors, s, bytes / s / 1048576);
+	}
+};
+
+//输出前limit条错误
+static void report(const vector<csverror>& errors, size_t limit = 20)
+{
+	for (size_t i = 0; i < errors.size() && i < limit; i++) fprintf(stderr, "第%d行：%s\n", errors[i].line, errors[i].message.c_str());
+	if (errors.size() > limit) fprintf(stderr, "……另有%zu个错误\n", errors.size() - limit);
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"用法：\n"
+		"  csvbatch validate <输入> [--columns N]\n"
+		"      检查每行能否解析、字段数是否为N\n"
+		"  csvbatch import <输入> <输出> [--columns N] [--key 列号]\n"
+		"      清洗导入：丢弃无法解析的行，按主键列去重（保留第一条），原子替换输出文件\n"
+		"      去重需要在内存中保存已出现的主键，内存随不同主键的数量增长\n"
+		"  csvbatch export <输入> <输出> [--select 列号,列号,...]\n"
+		"      按给定顺序导出部分列\n"
+		"有错误时返回1，参数错误或读写失败时返回2\n");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		usage();
+		return 2;
+	}
+	string command = argv[1];
+	vector<string> files;
+	long key = -1;
+	vector<size_t> select;
+	for (int i = 2; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg == "--columns" && i + 1 < argc) CsvRow::expected = strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--key" && i + 1 < argc) key = strtol(argv[++i], nullptr, 10);
+		else if (arg == "--select" && i + 1 < argc)
+		{
+			vector<string>* parts = split_tovector(argv[++i], ',');
+			for (auto& p : *parts) select.push_back(strtoul(p.c_str(), nullptr, 10));
+			delete parts;
+		}
+		else files.push_back(arg);
+	}
+	bool needOutput = command == "import" || command == "export";
+	if ((command != "validate" && !needOutput) || files.size() != (needOutput ? 2u : 1u))
+	{
+		usage();
+		return 2;
+	}
+	if (!filesystem::exists(files[0]))
+	{
+		fprintf(stderr, "找不到文件 %s\n", files[0].c_str());
+		return 2;
+	}
+
+	csvfile<CsvRow> input(files[0]);
+	vector<csverror> errors;
+	Progress progress;
+	auto onProgress = [&progress](uintmax_t done, uintmax_t total) {progress.Update(done, total); };
+	bool ok = true;
+
+	if (command == "validate")
+	{
+		ok = input.read_stream([&](CsvRow&) {progress.rows++; }, &errors, onProgress);
+	}
+	else
+	{
+		csvfile<CsvRow> output(files[1]);
+		//已出现的主键，流式处理中唯一随输入增长的部分
+		unordered_set<string> keys;
+		size_t duplicates = 0;
+		CsvRow projected;
+		//读取失败或写出失败时fill返回false，write_stream放弃替换，输出文件保持原样
+		ok = output.write_stream([&](auto& emit)
+			{
+				return input.read_stream([&](CsvRow& row)
+					{
+						progress.rows++;
+						if (command == "import")
+						{
+							if (key >= 0)
+							{
+								if ((size_t)key >= row.fields.size() || !keys.insert(row.fields[key]).second)
+								{
+									duplicates++;
+									return true;
+								}
+							}
+							return emit(row);
+						}
+						if (select.empty()) return emit(row);
+						projected.fields.resize(select.size());
+						for (size_t i = 0; i < select.size(); i++)
+							projected.fields[i] = select[i] < row.fields.size() ? row.fields[select[i]] : string();
+						return emit(projected);
+					}, &errors, onProgress);
+			});
+		if (duplicates > 0) fprintf(stderr, "\n跳过%zu行主键重复或缺少主键列的记录", duplicates);
+	}
+
+	progress.errors = errors.size();
+	progress.Summary(command.c_str());
+	report(errors);
+	if (!ok)
+	{
+		fprintf(stderr, "读写失败\n");
+		return 2;
+	}
+	return errors.empty() ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+﻿#pragma once
+#include<vector>
+#include<memory>
+#include<functional>
+#include<future>
+#include"framework.h"
+#include"csvfile.h"
+#include"thread_pool.h"
+using namespace std;
+
+/// <summary>
+/// 写时复制的记录集合。Snapshot()只复制一个指针，之后的修改才复制被修改的部分：
+/// 第一次修改时复制指针数组，被修改的记录再单独复制一份，快照中的记录始终不变
+/// </summary>
+template<typename T>
+class CowCollection
+{
+public:
+	typedef vector<shared_ptr<T>> Records;
+private:
+	shared_ptr<Records> records = make_shared<Records>();
+
+	//快照仍在使用指针数组时先复制一份
+	Records& own()
+	{
+		if (records.use_count() > 1) records = make_shared<Records>(*records);
+		return *records;
+	}
+public:
+	CowCollection() {}
+	//接管已读取的记录
+	CowCollection(const vector<T*>& origin)
+	{
+		records->reserve(origin.size());
+		for (auto i : origin) records->push_back(shared_ptr<T>(i));
+	}
+
+	size_t Size() { return records->size(); }
+	//只读访问
+	const T* Get(size_t i) { return (*records)[i].get(); }
+	//可写访问，记录被快照共享时先复制
+	T* Edit(size_t i)
+	{
+		Records& r = own();
+		if (r[i].use_count() > 1) r[i] = make_shared<T>(*r[i]);
+		return r[i].get();
+	}
+	void Add(const T& value) { own().push_back(make_shared<T>(value)); }
+	void Add(T&& value) { own().push_back(make_shared<T>(std::move(value))); }
+	void Erase(size_t i)
+	{
+		Records& r = own();
+		r.erase(r.begin() + i);
+	}
+	//当前内容的只读快照，O(1)
+	shared_ptr<const Records> Snapshot() { return records; }
+};
+
+/// <summary>
+/// 后台保存器：在线程池上序列化并写入快照，完成后在画布线程回调。
+/// 保存进行中再次请求时只记住最新的快照，当前保存结束后合并为一次写入
+/// </summary>
+template<typename T>
+class AsyncSaver
+{
+	typedef typename CowCollection<T>::Records Records;
+	//后台任务与画布线程共享的状态，保存器析构后后台任务仍可安全访问
+	struct State
+	{
+		csvfile<T> file;
+		bool alive = true;
+		bool inFlight = false;  //是否有保存正在进行
+		shared_ptr<const Records> pending;  //等待写入的最新快照
+		vector<function<void(bool)>> waiting;  //等待当前保存结果的回调
+		vector<function<void(bool)>> next;  //等待下一次保存结果的回调
+		future<void> job;
+		State(const string& path) : file(path) {}
+	};
+	Canvas& canvas;
+	shared_ptr<State> state;
+
+	//在后台写入快照，只在画布线程调用
+	static void start(Canvas& canvas, shared_ptr<State> s, shared_ptr<const Records> snapshot)
+	{
+		s->inFlight = true;
+		s->job = ThreadPool::Shared().Submit([&canvas, s, snapshot]()
+			{
+				vector<T*> rows;
+				rows.reserve(snapshot->size());
+				for (auto& i : *snapshot) rows.push_back(i.get());
+				bool ok = s->file.write(rows);
+				canvas.Post([&canvas, s, ok]() {finish(canvas, s, ok); });
+			});
+	}
+	//保存结束，在画布线程回调并启动合并后的下一次保存
+	static void finish(Canvas& canvas, shared_ptr<State> s, bool ok)
+	{
+		if (!s->alive) return;
+		s->inFlight = false;
+		vector<function<void(bool)>> done;
+		done.swap(s->waiting);
+		if (s->pending != nullptr)
+		{
+			s->waiting.swap(s->next);
+			shared_ptr<const Records> snapshot = s->pending;
+			s->pending = nullptr;
+			start(canvas, s, snapshot);
+		}
+		for (auto& i : done) if (i) i(ok);
+	}
+public:
+	//形参：画布（用于回到画布线程），csv路径
+	AsyncSaver(Canvas& canvas, const string& path) : canvas(canvas), state(make_shared<State>(path)) {}
+	//等待正在进行的写入结束，之后不再回调
+	~AsyncSaver()
+	{
+		state->alive = false;
+		if (state->job.valid()) state->job.wait();
+	}
+	AsyncSaver(const AsyncSaver&) = delete;
+	AsyncSaver& operator=(const AsyncSaver&) = delete;
+
+	/// <summary>
+	/// 请求保存，立即返回。done在画布线程上以保存是否成功为参数调用
+	/// </summary>
+	void SaveAsync(CowCollection<T>& records, function<void(bool)> done = nullptr)
+	{
+		if (state->inFlight)
+		{
+			state->pending = records.Snapshot();
+			state->next.push_back(done);
+			return;
+		}
+		state->waiting.push_back(done);
+		start(canvas, state, records.Snapshot());
+	}
+	//是否有保存正在进行或排队
+	bool Busy() { return state->inFlight; }
+};
@@ -0,0 +1,267 @@
+﻿#pragma once
+#include<string>
+#include<string_view>
+#include<vector>
+#include<cstring>
+#include<cstdint>
+#include<cassert>
+#include<filesystem>
+#include<chrono>
+#include"tools.h"
+using namespace std;
+
+//快照文件格式（小端，各段按8字节对齐）：
+//文件头 | 列目录 | 各列数据
+//整数列与浮点列为连续的8字节数组，字符串列为rows+1个偏移量加字符数据
+//格式变化时递增版本号，旧快照会被当作过期重建
+
+//快照列类型
+enum class SnapshotColumnType : uint32_t
+{
+	Int64 = 1,
+	Double = 2,
+	String = 3,
+};
+
+//快照对应的csv状态，大小和修改时间一致时快照有效。
+//记录状态时csv刚被修改过的，修改时间的精度可能分辨不出紧接着的另一次写入，此时另外记录内容哈希，校验时再比较哈希
+struct SnapshotStamp
+{
+	uint64_t size = 0;
+	int64_t time = 0;
+	uint64_t hash = 0;  //只在suspect时计算
+	uint32_t suspect = 0;  //记录时csv的修改时间距当时太近，需要比较哈希
+	uint32_t reserved = 0;
+
+	//修改时间距记录时刻小于该值（文件时钟单位）时视为可疑
+	static int64_t suspect_window()
+	{
+		return (int64_t)chrono::duration_cast<filesystem::file_time_type::duration>(chrono::seconds(2)).count();
+	}
+	static bool hash_of(const string& path, uint64_t& hash)
+	{
+		MappedFile csv;
+		if (!csv.Open(path)) return false;
+		hash = hashBytes(csv.Data(), csv.Size());
+		return true;
+	}
+	//计算csv文件当前的状态，只有刚被修改过的文件才读取内容计算哈希
+	static bool Of(const string& path, SnapshotStamp& stamp)
+	{
+		error_code ec;
+		stamp.size = filesystem::file_size(path, ec);
+		if (ec) return false;
+		stamp.time = (int64_t)filesystem::last_write_time(path, ec).time_since_epoch().count();
+		if (ec) return false;
+		int64_t now = (int64_t)filesystem::file_time_type::clock::now().time_since_epoch().count();
+		stamp.hash = 0;
+		stamp.suspect = now - stamp.time < suspect_window() ? 1 : 0;
+		if (stamp.suspect && !hash_of(path, stamp.hash)) return false;
+		return true;
+	}
+	//快照中记录的状态saved是否仍对应path的当前状态（即本对象）。saved可疑时补算当前哈希再比较
+	bool Matches(const SnapshotStamp& saved, const string& path)
+	{
+		if (size != saved.size || time != saved.time) return false;
+		if (!saved.suspect) return true;
+		if (!suspect)
+		{
+			if (!hash_of(path, hash)) return false;
+			suspect = 1;
+		}
+		return hash == saved.hash;
+	}
+};
+
+//快照文件头
+struct SnapshotHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t columnCount;
+	uint64_t rows;
+	SnapshotStamp stamp;
+};
+//快照列目录项
+struct SnapshotColumnEntry
+{
+	SnapshotColumnType type;
+	uint32_t reserved;
+	uint64_t offset;  //列数据在文件中的位置
+	uint64_t size;  //列数据字节数
+};
+
+static const char snapshotMagic[8] = { 'Y','N','S','N','A','P','\0','\0' };
+static const uint32_t snapshotVersion = 2;
+
+//快照写入器，记录逐行写入，在内存中按列累积
+class SnapshotWriter
+{
+	struct Column
+	{
+		SnapshotColumnType type;
+		vector<int64_t> ints;
+		vector<double> doubles;
+		vector<uint64_t> offsets{ 0 };
+		string chars;
+
+		Column(SnapshotColumnType type) : type(type) {}
+	};
+	vector<Column> columns;
+	uint64_t rows = 0;
+
+	Column& column(int col, SnapshotColumnType type)
+	{
+		while ((int)columns.size() <= col) columns.emplace_back(type);
+		assert(columns[col].type == type);
+		return columns[col];
+	}
+	//追加数据并补齐到8字节
+	static void append_aligned(string& out, const void* data, size_t len)
+	{
+		out.append((const char*)data, len);
+		out.append((8 - out.size() % 8) % 8, '\0');
+	}
+public:
+	void Int(int col, int64_t value) { column(col, SnapshotColumnType::Int64).ints.push_back(value); }
+	void Double(int col, double value) { column(col, SnapshotColumnType::Double).doubles.push_back(value); }
+	void String(int col, string_view value)
+	{
+		Column& c = column(col, SnapshotColumnType::String);
+		c.chars.append(value.data(), value.size());
+		c.offsets.push_back(c.chars.size());
+	}
+	//结束一行
+	void EndRow() { rows++; }
+	//已写入的各列类型
+	vector<SnapshotColumnType> Types() const
+	{
+		vector<SnapshotColumnType> types;
+		for (auto& c : columns) types.push_back(c.type);
+		return types;
+	}
+
+	//写入快照文件，buffer为复用的写缓冲区
+	bool Save(const string& path, const SnapshotStamp& stamp, string& buffer)
+	{
+		AtomicFileWriter fout(path, buffer);
+		if (!fout.Open()) return false;
+
+		SnapshotHeader header;
+		memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+		header.version = snapshotVersion;
+		header.columnCount = (uint32_t)columns.size();
+		header.rows = rows;
+		header.stamp = stamp;
+
+		//先算出每列的位置
+		vector<SnapshotColumnEntry> entries(columns.size());
+		uint64_t offset = sizeof(SnapshotHeader) + sizeof(SnapshotColumnEntry) * columns.size();
+		offset = (offset + 7) / 8 * 8;
+		for (size_t i = 0; i < columns.size(); i++)
+		{
+			Column& c = columns[i];
+			uint64_t size = 0;
+			if (c.type == SnapshotColumnType::Int64) size = c.ints.size() * 8;
+			else if (c.type == SnapshotColumnType::Double) size = c.doubles.size() * 8;
+			else size = c.offsets.size() * 8 + c.chars.size();
+			entries[i] = { c.type,0,offset,size };
+			offset += (size + 7) / 8 * 8;
+		}
+
+		append_aligned(buffer, &header, sizeof(header));
+		buffer.append((const char*)entries.data(), entries.size() * sizeof(SnapshotColumnEntry));
+		buffer.append((8 - buffer.size() % 8) % 8, '\0');
+		for (auto& c : columns)
+		{
+			if (c.type == SnapshotColumnType::Int64) append_aligned(buffer, c.ints.data(), c.ints.size() * 8);
+			else if (c.type == SnapshotColumnType::Double) append_aligned(buffer, c.doubles.data(), c.doubles.size() * 8);
+			else
+			{
+				buffer.append((const char*)c.offsets.data(), c.offsets.size() * 8);
+				append_aligned(buffer, c.chars.data(), c.chars.size());
+			}
+			if (!fout.Flush()) return false;
+		}
+		return fout.Commit();
+	}
+};
+
+//快照读取器，通过内存映射直接访问各列，不做整体拷贝
+class SnapshotReader
+{
+	MappedFile file;
+	const SnapshotHeader* header = nullptr;
+	const SnapshotColumnEntry* entries = nullptr;
+
+	//Open已经检查过列类型，这里的断言只用于发现记录类型读写列不对称的错误
+	const char* column(int col, SnapshotColumnType type) const
+	{
+		assert(col < (int)header->columnCount && entries[col].type == type);
+		return file.Data() + entries[col].offset;
+	}
+	//检查一列的位置、长度与行数一致，字符串列的偏移量从0开始单调不减且不超出字符数据
+	bool valid_column(const SnapshotColumnEntry& e) const
+	{
+		uint64_t rows = header->rows;
+		if (e.offset % 8 != 0 || e.offset > file.Size() || e.size > file.Size() - e.offset) return false;
+		if (e.type == SnapshotColumnType::Int64 || e.type == SnapshotColumnType::Double) return e.size == rows * 8;
+		if (e.type != SnapshotColumnType::String || e.size < (rows + 1) * 8) return false;
+		const uint64_t* offsets = (const uint64_t*)(file.Data() + e.offset);
+		uint64_t chars = e.size - (rows + 1) * 8;
+		if (offsets[0] != 0 || offsets[rows] != chars) return false;
+		for (uint64_t i = 0; i < rows; i++)
+			if (offsets[i] > offsets[i + 1]) return false;
+		return true;
+	}
+public:
+	/// <summary>
+	/// 打开快照，stamp为csvPath当前的状态，types为记录类型写出的各列类型。
+	/// 版本、csv状态、列类型不一致，或文件被截断、列长度与行数不符时返回false，调用者应改为解析csv
+	/// </summary>
+	bool Open(const string& path, SnapshotStamp& stamp, const string& csvPath, const vector<SnapshotColumnType>& types)
+	{
+		if (!file.Open(path) || file.Size() < sizeof(SnapshotHeader)) return false;
+		header = (const SnapshotHeader*)file.Data();
+		if (memcmp(header->magic, snapshotMagic, sizeof(snapshotMagic)) != 0 || header->version != snapshotVersion) return false;
+		if (!stamp.Matches(header->stamp, csvPath)) return false;
+		if (header->columnCount != types.size() || header->rows > file.Size() / 8) return false;
+		if (sizeof(SnapshotHeader) + sizeof(SnapshotColumnEntry) * header->columnCount > file.Size()) return false;
+		entries = (const SnapshotColumnEntry*)(file.Data() + sizeof(SnapshotHeader));
+		for (uint32_t i = 0; i < header->columnCount; i++)
+		{
+			if (entries[i].type != types[i] || !valid_column(entries[i])) return false;
+		}
+		return true;
+	}
+	size_t Rows() const { return (size_t)header->rows; }
+	int Columns() const { return (int)header->columnCount; }
+
+	//整数列的连续数组，可以直接整体拷贝
+	const int64_t* Ints(int col) const { return (const int64_t*)column(col, SnapshotColumnType::Int64); }
+	//浮点列的连续数组，可以直接整体拷贝
+	const double* Doubles(int col) const { return (const double*)column(col, SnapshotColumnType::Double); }
+
+	int64_t Int(int col, size_t row) const { return Ints(col)[row]; }
+	double Double(int col, size_t row) const { return Doubles(col)[row]; }
+	string_view String(int col, size_t row) const
+	{
+		const uint64_t* offsets = Offsets(col);
+		return string_view(Chars(col) + offsets[row], (size_t)(offsets[row + 1] - offsets[row]));
+	}
+	//字符串列的rows+1个偏移量，第i行为[offsets[i], offsets[i+1])
+	const uint64_t* Offsets(int col) const { return (const uint64_t*)column(col, SnapshotColumnType::String); }
+	//字符串列的字符数据
+	const char* Chars(int col) const { return (const char*)(Offsets(col) + header->rows + 1); }
+};
+
+//可选接口：记录类型实现后，csvfile::read_cached可以为其维护二进制快照。
+//记录类型另外提供静态函数FromSnapshotColumns(reader, 记录数组)时，read_cached改为按列整体读取
+class ISnapshotRecord
+{
+public:
+	//把当前记录按列写入快照，列号与类型在所有记录间必须一致
+	virtual void ToSnapshot(SnapshotWriter& writer) = 0;
+	//从快照的第row行恢复记录
+	virtual void FromSnapshot(const SnapshotReader& reader, size_t row) = 0;
+};
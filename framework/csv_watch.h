@@ -0,0 +1,274 @@
+﻿#pragma once
+#include<string>
+#include<vector>
+#include<functional>
+#include<unordered_map>
+#include<optional>
+#include<string_view>
+#include<chrono>
+#include<filesystem>
+#include"csvfile.h"
+#include"record_store.h"
+#include"record_index.h"
+using namespace std;
+
+//一次重新加载的结果
+struct CsvReloadResult
+{
+	size_t inserted = 0;  //新增记录数
+	size_t updated = 0;  //内容变化的记录数
+	size_t erased = 0;  //被删除的记录数
+	vector<csverror> errors;  //无法解析、主键重复或被容器拒绝的行
+	bool Changed() const { return inserted + updated + erased > 0; }
+};
+
+/// <summary>
+/// 监视csv文件并把外部修改增量应用到记录容器：只有新增、变化、删除的记录会触达容器，
+/// 挂接在容器上的索引随之更新。Windows下使用目录变化通知，不可用时退回定时轮询。
+/// 提供日志主键时同时监视增量日志（path.log），日志中的变化像csvfile::read一样叠加在csv上。
+/// 每帧（例如在OnUpdate中）调用Poll即可
+/// </summary>
+/// <typeparam name="T">记录类型，需要实现ISerializable</typeparam>
+/// <typeparam name="K">主键类型</typeparam>
+template<typename T, typename K>
+class CsvWatcher
+{
+	string path;
+	RecordStore<T>& store;
+	function<K(const T&)> key;
+	function<string(T*)> logKey;  //增量日志使用的主键，为空时不读取日志
+	HashIndex<T, K> byKey;  //主键到句柄的唯一索引
+	vector<pair<uint64_t, RecordHandle>> rows;  //已加载记录的行哈希
+	unordered_map<uint64_t, string> rowKeys;  //行哈希到日志主键，csv行被日志覆盖时据此判断，不必重新解析
+	FileChangeNotifier notifier;
+	bool native = false;  //是否使用目录变化通知
+	int intervalMs;  //轮询间隔
+	chrono::steady_clock::time_point lastPoll;
+	uintmax_t lastSize[2] = { 0,0 };  //csv和日志的大小
+	long long lastTime[2] = { 0,0 };  //csv和日志的修改时间
+
+	//csv或日志的大小、修改时间是否与上次加载时不同
+	bool stamp_changed()
+	{
+		bool changed = false;
+		string files[2] = { path,path + ".log" };
+		for (int i = 0; i < 2; i++)
+		{
+			error_code ec;
+			uintmax_t size = filesystem::file_size(files[i], ec);
+			if (ec) size = 0;
+			long long time = (long long)filesystem::last_write_time(files[i], ec).time_since_epoch().count();
+			if (ec) time = 0;
+			if (size == lastSize[i] && time == lastTime[i]) continue;
+			lastSize[i] = size;
+			lastTime[i] = time;
+			changed = true;
+		}
+		return changed;
+	}
+public:
+	/// <summary>
+	/// 形参：csv路径，被绑定的容器（应为空，由监视器完成首次加载），取主键函数，轮询间隔（毫秒），
+	/// 增量日志的主键（与写入方csvfile使用的相同，为空时忽略日志）
+	/// </summary>
+	CsvWatcher(const string& path, RecordStore<T>& store, function<K(const T&)> key, int intervalMs = 500, function<string(T*)> logKey = nullptr)
+		: path(path), store(store), key(key), logKey(logKey), byKey(store, key, true), intervalMs(intervalMs)
+	{
+		checkAndCreatePathAndFile(path);
+		filesystem::path dir = filesystem::absolute(filesystem::path(path)).parent_path();
+		native = notifier.Open(dir.string());
+		lastPoll = chrono::steady_clock::now();
+		Reload();
+	}
+
+	//有外部修改时重新加载，返回是否应用了变化
+	bool Poll(CsvReloadResult* result = nullptr)
+	{
+		if (native)
+		{
+			if (!notifier.Changed()) return false;
+		}
+		else
+		{
+			auto now = chrono::steady_clock::now();
+			if (now - lastPoll < chrono::milliseconds(intervalMs)) return false;
+			lastPoll = now;
+		}
+		if (!stamp_changed()) return false;
+		CsvReloadResult r = Reload();
+		if (result != nullptr) *result = r;
+		return r.Changed();
+	}
+
+	/// <summary>
+	/// 读取文件并与已加载记录逐行比较。内容未变的行只计算哈希不解析，
+	/// 其余行按主键区分为修改或新增，文件中不再出现的记录被删除。
+	/// 日志中的条目覆盖csv内同主键的行，日志删除的记录视为不在文件中
+	/// </summary>
+	CsvReloadResult Reload()
+	{
+		CsvReloadResult r;
+		stamp_changed();
+		ifstream fin(path, ios::binary);
+		string data((istreambuf_iterator<char>(fin)), istreambuf_iterator<char>());
+		fin.close();
+
+		//每个主键在日志中的最终状态，row为空表示已删除
+		struct Overlay { optional<string> row; int line = 0; bool used = false; };
+		unordered_map<string, Overlay> overlay;
+		vector<string> overlayOrder;  //日志中首次出现的顺序，不在csv中的新增记录按此追加
+		if (logKey)
+		{
+			csvfile<T>(path).read_log([&](char op, string_view entry, string_view row, int line)
+				{
+					auto it = overlay.try_emplace(string(entry));
+					if (it.second) overlayOrder.push_back(it.first->first);
+					Overlay& o = it.first->second;
+					if (op == 'U') o.row = string(row);
+					else o.row.reset();
+					o.line = line;
+				});
+		}
+
+		//旧行按哈希分组，同一哈希可能对应多条内容相同的记录
+		unordered_multimap<uint64_t, RecordHandle> old;
+		old.reserve(rows.size());
+		for (auto& i : rows) old.insert(i);
+
+		vector<pair<uint64_t, RecordHandle>> now;
+		now.reserve(rows.size());
+		unordered_map<uint64_t, string> keys;
+		//解析后才能确定身份的行，fromLog表示行来自日志
+		struct Changed { int line; uint64_t hash; string_view row; bool fromLog; };
+		vector<Changed> changed;
+		auto match = [&](int line, uint64_t h, string_view row, bool fromLog)
+			{
+				if (logKey)
+				{
+					auto k = rowKeys.find(h);
+					if (k != rowKeys.end()) keys.insert(*k);
+				}
+				auto it = old.find(h);
+				if (it != old.end())
+				{
+					now.push_back({ h,it->second });
+					old.erase(it);
+				}
+				else changed.push_back({ line,h,row,fromLog });
+			};
+		//行的日志主键，优先使用上次加载时记下的结果
+		auto key_of = [&](uint64_t h, string_view row, int line, bool fromLog, string& k)
+			{
+				auto it = rowKeys.find(h);
+				if (it != rowKeys.end()) k = it->second;
+				else
+				{
+					T t;
+					try
+					{
+						t.FromCsvRow(string(row));
+					}
+					catch (const exception& e)
+					{
+						r.errors.push_back({ line,string(fromLog ? "增量日志：" : "") + e.what() });
+						return false;
+					}
+					k = logKey(&t);
+				}
+				keys[h] = k;
+				return true;
+			};
+		csvfile<T>::each_record(data, 0, data.size(), 1, [&](int line, size_t p, size_t len)
+			{
+				string_view row(data.data() + p, len);
+				uint64_t h = hashBytes(row.data(), row.size());
+				if (!overlay.empty())
+				{
+					string k;
+					if (!key_of(h, row, line, false, k)) return;
+					auto o = overlay.find(k);
+					if (o != overlay.end())
+					{
+						o->second.used = true;
+						if (!o->second.row) return;
+						row = *o->second.row;
+						match(o->second.line, hashBytes(row.data(), row.size()), row, true);
+						return;
+					}
+				}
+				match(line, h, row, false);
+			}, &r.errors);
+		//日志中新增、csv中没有的记录
+		for (auto& k : overlayOrder)
+		{
+			Overlay& o = overlay[k];
+			if (o.used || !o.row) continue;
+			string_view row = *o.row;
+			match(o.line, hashBytes(row.data(), row.size()), row, true);
+		}
+
+		//没有匹配到内容的旧记录，稍后可能被同主键的新内容替换，pending为false表示已被替换
+		auto handle_id = [](RecordHandle h) {return ((uint64_t)h.index << 32) | h.generation; };
+		struct Unmatched { uint64_t hash; bool pending; };
+		unordered_map<uint64_t, Unmatched> unmatched;
+		for (auto& i : old) unmatched[handle_id(i.second)] = { i.first,true };
+
+		for (auto& c : changed)
+		{
+			const char* source = c.fromLog ? "增量日志：" : "";
+			T t;
+			try
+			{
+				t.FromCsvRow(string(c.row));
+			}
+			catch (const exception& e)
+			{
+				r.errors.push_back({ c.line,source + string(e.what()) });
+				continue;
+			}
+			if (logKey) keys[c.hash] = logKey(&t);
+			RecordHandle h = byKey.Find(key(t));
+			if (h.Valid())
+			{
+				auto it = unmatched.find(handle_id(h));
+				if (it == unmatched.end() || !it->second.pending)
+				{
+					r.errors.push_back({ c.line,source + string("主键重复") });
+					continue;
+				}
+				it->second.pending = false;
+				//被容器拒绝（例如违反其他唯一索引）时保留旧内容，下次加载仍会重试
+				if (!store.Update(h, std::move(t)))
+				{
+					r.errors.push_back({ c.line,source + string("记录被容器拒绝") });
+					now.push_back({ it->second.hash,h });
+					continue;
+				}
+				now.push_back({ c.hash,h });
+				r.updated++;
+			}
+			else
+			{
+				h = store.Insert(std::move(t));
+				if (!h.Valid())
+				{
+					r.errors.push_back({ c.line,source + string("记录被容器拒绝") });
+					continue;
+				}
+				now.push_back({ c.hash,h });
+				r.inserted++;
+			}
+		}
+		for (auto& i : old)
+		{
+			if (unmatched[handle_id(i.second)].pending)
+			{
+				store.Erase(i.second);
+				r.erased++;
+			}
+		}
+		rows.swap(now);
+		rowKeys.swap(keys);
+		return r;
+	}
+};
\ No newline at end of file
@@ -3,7 +3,20 @@
 #include<vector>
 #include<iostream>
 #include<fstream>
+#include<exception>
+#include<cassert>
+#include<cstdio>
+#include<functional>
+#include<unordered_map>
+#include<filesystem>
+#include<algorithm>
+#include<charconv>
+#include<type_traits>
+#include<stdexcept>
 #include"tools.h"
+#include"thread_pool.h"
+#include"csv_snapshot.h"
+#include"record_store.h"
 using namespace std;
 
 
@@ -13,50 +26,708 @@ class ISerializable
 public:
 	virtual string ToCsvRow() = 0;
 	virtual void FromCsvRow(string str) = 0;
+	//把一行追加到写入缓冲区，默认转调ToCsvRow，可重写为直接格式化以省去中间字符串
+	virtual void AppendCsvRow(string& out) { out += ToCsvRow(); }
+	virtual ~ISerializable() {}
 };
 
+//读取时单条记录的解析错误
+struct csverror
+{
+	int line;  //记录起始行号，从1开始
+	string message;  //错误信息
+};
+
+//记录类型是否提供按列整体读取快照的静态函数FromSnapshotColumns
+template<typename T, typename = void>
+struct has_snapshot_columns : false_type {};
+template<typename T>
+struct has_snapshot_columns<T, void_t<decltype(T::FromSnapshotColumns(declval<const SnapshotReader&>(), declval<const vector<T*>&>()))>> : true_type {};
+
 template<typename T>
 class csvfile
 {
 	string path;
+	function<string(T*)> key;  //记录主键，启用增量日志时必须提供
+	uintmax_t compactThreshold = 64 * 1024 * 1024;  //日志超过该字节数时压缩回csv
+	string buffer;  //写入缓冲区，多次保存之间复用
+	static const size_t flushSize = 4 * 1024 * 1024;  //缓冲区超过该大小时写入磁盘
+
+	//增量日志文件，与csv放在一起
+	string log_path() { return path + ".log"; }
+
+	//当前日志大小，不存在时为0
+	uintmax_t log_size()
+	{
+		error_code ec;
+		uintmax_t size = filesystem::file_size(log_path(), ec);
+		return ec ? 0 : size;
+	}
+
+	//清空日志，csv已经包含日志中的全部变化时调用
+	void truncate_log()
+	{
+		if (log_size() > 0) ofstream(log_path(), ios::binary | ios::trunc).close();
+	}
+
+	//日志头，记录日志开始时csv的大小和修改时间，csv被整体替换后旧日志随之失效
+	string log_header()
+	{
+		error_code ec;
+		uintmax_t size = filesystem::file_size(path, ec);
+		long long time = (long long)filesystem::last_write_time(path, ec).time_since_epoch().count();
+		return "L " + to_string(size) + " " + to_string(time) + "\n";
+	}
+
+	//日志头是否与csv当前的大小和修改时间一致，空日志视为一致
+	bool log_matches()
+	{
+		if (log_size() == 0) return true;
+		ifstream fin(log_path(), ios::binary);
+		string first;
+		getline(fin, first);
+		return first + "\n" == log_header();
+	}
+
+	//把与csv不一致的日志改名保留为path.log.staleN，不删除其中的数据，交给人工核对
+	bool set_aside_log()
+	{
+		error_code ec;
+		for (int i = 0;; i++)
+		{
+			string target = log_path() + ".stale" + (i == 0 ? string() : to_string(i));
+			if (filesystem::exists(target, ec)) continue;
+			filesystem::rename(log_path(), target, ec);
+			return !ec;
+		}
+	}
+
+	//读取结果的元素可以是T*（由调用者持有）或T（按值暂存，之后移入RecordStore）
+	template<typename E>
+	static T* record_of(E& e)
+	{
+		if constexpr (is_pointer<E>::value) return e;
+		else return &e;
+	}
+	//新建一个空记录元素
+	template<typename E>
+	static E new_record()
+	{
+		if constexpr (is_pointer<E>::value) return new T();
+		else return T();
+	}
+	//释放元素持有的记录
+	template<typename E>
+	static void release_record(E& e)
+	{
+		if constexpr (is_pointer<E>::value)
+		{
+			delete e;
+			e = nullptr;
+		}
+	}
+
+	//解析日志条目头中的长度字段，p指向字段前的空格，end为条目头的行尾
+	static bool parse_length(const char*& p, const char* end, size_t& value)
+	{
+		if (p >= end || *p != ' ') return false;
+		auto r = from_chars(p + 1, end, value);
+		if (r.ec != errc()) return false;
+		p = r.ptr;
+		return true;
+	}
+
+	//从p开始逐条扫描日志条目，f(op, key, row, line)返回false时停止，line为条目头在日志文件中的行号。
+	//返回停止的位置，之后是不完整或被f拒绝的部分
+	template<typename F>
+	static size_t scan_log(const string& data, size_t p, F f)
+	{
+		int line = 2;  //日志头占第1行
+		while (p < data.size())
+		{
+			size_t headEnd = data.find('\n', p);
+			if (headEnd == string::npos) break;
+			char op = data[p];
+			size_t keyLen = 0, rowLen = 0;
+			//长度字段只在条目头内解析，不扫描日志的其余部分
+			const char* field = data.data() + p + 1;
+			const char* fieldEnd = data.data() + headEnd;
+			if (op == 'U' && (!parse_length(field, fieldEnd, keyLen) || !parse_length(field, fieldEnd, rowLen))) break;
+			if (op == 'D' && !parse_length(field, fieldEnd, keyLen)) break;
+			if (op != 'U' && op != 'D') break;
+			size_t body = headEnd + 1;
+			if (body + keyLen + rowLen + 1 > data.size()) break;
+			if (!f(op, string_view(data.data() + body, keyLen), string_view(data.data() + body + keyLen, rowLen), line)) break;
+			size_t next = body + keyLen + rowLen + 1;
+			line += 1 + (int)count(data.begin() + body, data.begin() + next, '\n');
+			p = next;
+		}
+		return p;
+	}
+
+	//把日志重放到已读取的记录上：U为新增或修改，D为删除。
+	//日志尾部不完整的条目（保存时崩溃）被忽略；无法解析的记录写入errors，重放停在它之前的最后一条完整条目
+	template<typename E>
+	void apply_log(vector<E>& records, vector<csverror>* errors = nullptr)
+	{
+		if (!key || log_size() == 0) return;
+		string data;
+		ifstream fin(log_path(), ios::binary);
+		data.assign(istreambuf_iterator<char>(fin), istreambuf_iterator<char>());
+		fin.close();
+
+		//csv在日志之外被修改过（替换后清空日志前崩溃、复制、恢复备份、外部编辑等），无法判断日志中的变化是否已包含在csv内，
+		//不重放也不删除日志，报告后由下次保存改名保留
+		string header = log_header();
+		if (data.compare(0, header.size(), header) != 0)
+		{
+			if (errors != nullptr) errors->push_back({ 1,"增量日志与csv的大小或修改时间不一致，未重放：" + log_path() });
+			return;
+		}
+
+		unordered_map<string, size_t> pos;
+		pos.reserve(records.size());
+		for (size_t i = 0; i < records.size(); i++) pos[key(record_of(records[i]))] = i;
+		vector<char> erased(records.size(), 0);
+
+		bool rejected = false;  //是否停在无法解析的完整条目上
+		size_t p = scan_log(data, header.size(), [&](char op, string_view entry, string_view row, int line)
+			{
+				string k(entry);
+				auto it = pos.find(k);
+				if (op == 'U')
+				{
+					E e = new_record<E>();
+					try
+					{
+						record_of(e)->FromCsvRow(string(row));
+					}
+					catch (const exception& ex)
+					{
+						release_record(e);
+						if (errors != nullptr) errors->push_back({ line,string("增量日志：") + ex.what() });
+						rejected = true;
+						return false;
+					}
+					if (it != pos.end())
+					{
+						release_record(records[it->second]);
+						records[it->second] = std::move(e);
+					}
+					else
+					{
+						pos[k] = records.size();
+						records.push_back(std::move(e));
+						erased.push_back(0);
+					}
+				}
+				else if (it != pos.end())
+				{
+					release_record(records[it->second]);
+					erased[it->second] = 1;
+					pos.erase(it);
+				}
+				return true;
+			});
+		//截掉保存时崩溃留下的不完整尾部，否则之后追加的条目会排在它后面而无法重放。
+		//无法解析的完整条目及其后的数据保留在日志中，只在压缩写回csv后清空
+		if (p < data.size() && !rejected)
+		{
+			error_code ec;
+			filesystem::resize_file(log_path(), p, ec);
+		}
+		//去掉被删除的空位，保持原有顺序
+		size_t n = 0;
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			if (erased[i]) continue;
+			if (n != i) records[n] = std::move(records[i]);
+			n++;
+		}
+		records.erase(records.begin() + n, records.end());
+	}
+
+	//把整个文件读入内存
+	bool load_all(string& data)
+	{
+		ifstream fin(path, ios::binary);
+		if (!fin) return false;
+		fin.seekg(0, ios::end);
+		streamoff size = fin.tellg();
+		fin.seekg(0, ios::beg);
+		data.resize((size_t)size);
+		if (size > 0) fin.read(&data[0], size);
+		return true;
+	}
+
+	//从from开始寻找引号外的换行，返回换行位置，没有则返回to
+	static size_t find_record_end(const string& data, size_t from, size_t to, bool& quoted)
+	{
+		for (size_t i = from; i < to; i++)
+		{
+			char c = data[i];
+			if (c == '"') quoted = !quoted;
+			else if (c == '\n' && !quoted) return i;
+		}
+		return to;
+	}
+
+	//解析[from,to)内的全部记录，firstLine为from所在行号
+	template<typename E>
+	static void parse_chunk(const string& data, size_t from, size_t to, int firstLine, vector<E>& out, vector<csverror>& errors)
+	{
+		each_record(data, from, to, firstLine, [&](int line, size_t p, size_t len)
+			{
+				out.push_back(new_record<E>());
+				try
+				{
+					record_of(out.back())->FromCsvRow(data.substr(p, len));
+				}
+				catch (const exception& e)
+				{
+					release_record(out.back());
+					out.pop_back();
+					errors.push_back({ line,e.what() });
+				}
+			}, &errors);
+	}
+	//没有提供errors时读取中的错误以异常抛出：释放已读取的记录后抛出第一处错误，不静默丢弃数据
+	template<typename E>
+	static void throw_errors(vector<E>& records, const vector<csverror>& errors)
+	{
+		if (errors.empty()) return;
+		for (auto& i : records) release_record(i);
+		records.clear();
+		const csverror& e = errors.front();
+		throw runtime_error("第" + to_string(e.line) + "行：" + e.message + (errors.size() > 1 ? "，共" + to_string(errors.size()) + "处错误" : ""));
+	}
 public:
+	//遍历[from,to)内的每条非空记录，f(起始行号, 起始位置, 长度)，长度不含行尾的\r\n。
+	//到to为止引号仍未闭合的记录不会吞掉其余内容：写入errors后跳过该行，从下一行继续
+	template<typename F>
+	static void each_record(const string& data, size_t from, size_t to, int firstLine, F f, vector<csverror>* errors = nullptr)
+	{
+		int line = firstLine;
+		size_t p = from;
+		while (p < to)
+		{
+			bool quoted = false;
+			size_t end = find_record_end(data, p, to, quoted);
+			if (quoted)
+			{
+				size_t lineEnd = data.find('\n', p);
+				if (lineEnd == string::npos || lineEnd > to) lineEnd = to;
+				if (errors != nullptr) errors->push_back({ line,"引号未闭合" });
+				line++;
+				p = lineEnd + 1;
+				continue;
+			}
+			size_t len = end - p;
+			if (len > 0 && data[p + len - 1] == '\r') len--;
+			int recordLine = line;
+			for (size_t i = p; i < end; i++) if (data[i] == '\n') line++;
+			line++;
+			if (len > 0) f(recordLine, p, len);
+			p = end + 1;
+		}
+	}
 
 	csvfile(string path) : path(path)
 	{
 		checkAndCreatePathAndFile(path);
 	}
+	//形参：文件路径，记录主键，提供主键后可以使用增量保存
+	csvfile(string path, function<string(T*)> key) : path(path), key(key)
+	{
+		checkAndCreatePathAndFile(path);
+	}
+
+	//设置日志压缩阈值（字节）
+	void set_compact_threshold(uintmax_t bytes) { compactThreshold = bytes; }
+
+	/// <summary>
+	/// 只读地扫描增量日志，f(op, key, row, line)依次收到每条完整条目：op为'U'时row为记录行，为'D'时row为空，line为日志中的行号。
+	/// 日志为空或已随csv整体替换而失效时返回false。不修改任何文件，可用于监视其他进程维护的数据
+	/// </summary>
+	template<typename F>
+	bool read_log(F f)
+	{
+		if (log_size() == 0) return false;
+		string data;
+		ifstream fin(log_path(), ios::binary);
+		data.assign(istreambuf_iterator<char>(fin), istreambuf_iterator<char>());
+		fin.close();
+		string header = log_header();
+		if (data.compare(0, header.size(), header) != 0) return false;
+		scan_log(data, header.size(), [&f](char op, string_view entry, string_view row, int line)
+			{
+				f(op, entry, row, line);
+				return true;
+			});
+		return true;
+	}
 
 
-	void write(vector<T*> obj)
+	//整体保存，先写入临时文件再原子替换，保存失败时原文件不变
+	bool write(const vector<T*>& obj)
 	{
-		
-		ofstream fout = ofstream(path);
+		return write_stream([&obj](auto& emit)
+			{
+				for (auto i : obj) if (!emit(*i)) return;
+			});
+	}
 
-		for (int i = 0; i < obj.size(); i++)
+	/// <summary>
+	/// 流式整体保存，记录不必同时在内存中：fill(emit)逐条调用emit(T&)写出记录，emit返回false表示写入失败，应停止。
+	/// fill可以返回bool，返回false表示数据来源失败（例如读取中断），此时放弃保存、原文件不变。
+	/// 与write相同，先写入临时文件再原子替换
+	/// </summary>
+	template<typename F>
+	bool write_stream(F fill)
+	{
+		//写入前判断，替换后csv的状态必然与日志头不同
+		bool stale = !log_matches();
+		AtomicFileWriter fout(path, buffer);
+		if (!fout.Open()) return false;
+		bool ok = true;
+		auto emit = [&](T& record)
+			{
+				if (!ok) return false;
+				record.AppendCsvRow(buffer);
+				buffer += '\n';
+				if (buffer.size() >= flushSize && !fout.Flush()) ok = false;
+				return ok;
+			};
+		if constexpr (is_same<decltype(fill(emit)), bool>::value)
 		{
-			fout << obj[i]->ToCsvRow() << endl;
+			if (!fill(emit)) return false;
 		}
-		fout.close();
+		else fill(emit);
+		if (!ok || !fout.Commit()) return false;
+		//新csv已经落盘，之前重放过的日志可以清空；没有重放过的不一致日志改名保留
+		if (stale) set_aside_log();
+		else truncate_log();
+		return true;
 	}
 
-	vector<T*> read()
+	/// <summary>
+	/// 增量保存，只把变化的记录追加到日志，耗时只与变化量有关；日志超过阈值时自动压缩回csv
+	/// </summary>
+	/// <param name="upserts">新增或修改过的记录</param>
+	/// <param name="erases">被删除记录的主键</param>
+	/// <param name="all">可选，当前全部记录，压缩时直接写出而不必从磁盘重放</param>
+	bool write_changes(const vector<T*>& upserts, const vector<string>& erases, vector<T*>* all = nullptr)
 	{
+		assert(key);
+		//不一致的日志无法再重放，追加到后面的变化也会随之失效，先改名保留再开始新日志
+		if (!log_matches() && !set_aside_log()) return false;
+		buffer.clear();
+		if (log_size() == 0) buffer += log_header();
+		char head[64];
+		for (auto i : upserts)
+		{
+			string k = key(i);
+			string row = i->ToCsvRow();
+			snprintf(head, sizeof(head), "U %zu %zu\n", k.size(), row.size());
+			buffer += head;
+			buffer += k;
+			buffer += row;
+			buffer += '\n';
+		}
+		for (auto& k : erases)
+		{
+			snprintf(head, sizeof(head), "D %zu\n", k.size());
+			buffer += head;
+			buffer += k;
+			buffer += '\n';
+		}
+		if (!appendFileDurable(log_path(), buffer)) return false;
+
+		if (log_size() > compactThreshold) return compact(all);
+		return true;
+	}
 
-		ifstream fin (path);
+	//把日志合并回干净的csv并清空日志
+	bool compact(vector<T*>* all = nullptr)
+	{
+		if (all != nullptr) return write(*all);
+		vector<T*> temp = read();
+		bool ok = write(temp);
+		for (auto i : temp) delete i;
+		return ok;
+	}
+
+	/// <summary>
+	/// 在当前线程读取，记录的切分与read_parallel相同：引号内的换行属于字段，空行被跳过，引号未闭合的行单独报告。
+	/// 提供errors时解析失败的记录写入errors并跳过；不提供时遇到错误抛出runtime_error，说明第一处错误的行号
+	/// </summary>
+	vector<T*> read(vector<csverror>* errors = nullptr)
+	{
 		vector<T*> temp;
+		vector<csverror> local;
+		vector<csverror>* sink = errors != nullptr ? errors : &local;
+		string data;
+		if (load_all(data))
+		{
+			vector<csverror> parsed;
+			parse_chunk(data, 0, data.size(), 1, temp, parsed);
+			sink->insert(sink->end(), parsed.begin(), parsed.end());
+		}
+		apply_log(temp, sink);
+		throw_errors(temp, local);
+		return temp;
+	}
 
-		string line;
+	/// <summary>
+	/// 并行读取，按记录边界（引号内的换行不算边界）把文件切块后交给线程池解析，结果保持文件内的原始顺序
+	/// </summary>
+	/// <param name="errors">可选，输出解析失败的记录及其行号，失败的记录不会出现在返回值中，增量日志在拼接后重放。不提供时遇到错误抛出runtime_error</param>
+	/// <param name="chunks">切块数量，小于等于0时按线程池大小决定</param>
+	vector<T*> read_parallel(vector<csverror>* errors = nullptr, int chunks = 0)
+	{
+		vector<csverror> local;
+		vector<csverror>* sink = errors != nullptr ? errors : &local;
+		vector<T*> temp = parse_parallel(sink, chunks);
+		apply_log(temp, sink);
+		throw_errors(temp, local);
+		return temp;
+	}
 
+	/// <summary>
+	/// 并行读取到记录容器中，记录连续存放并由容器负责释放。不提供errors时遇到错误抛出runtime_error，容器不变
+	/// </summary>
+	void read_into(RecordStore<T>& store, vector<csverror>* errors = nullptr)
+	{
+		vector<csverror> local;
+		vector<csverror>* sink = errors != nullptr ? errors : &local;
+		vector<T> temp = parse_parallel<T>(sink, 0);
+		apply_log(temp, sink);
+		throw_errors(temp, local);
+		store.Reserve(store.Size() + temp.size());
+		for (auto& i : temp) store.Insert(std::move(i));
+	}
 
-		while (std::getline(fin, line))
+	/// <summary>
+	/// 优先从二进制快照（path.snap）读取，快照与csv的大小、修改时间不一致时重新解析csv并重建快照（快照保存时csv刚被修改过的还要比较内容哈希），
+	/// 记录类型需要实现ISnapshotRecord。csv有解析错误时不写快照，下次仍会报告这些错误；不提供errors时遇到错误抛出runtime_error
+	/// </summary>
+	vector<T*> read_cached(vector<csverror>* errors = nullptr)
+	{
+		static_assert(is_base_of<ISnapshotRecord, T>::value, "read_cached需要记录类型实现ISnapshotRecord");
+		vector<csverror> local;
+		vector<csverror>* sink = errors != nullptr ? errors : &local;
+		vector<T*> temp;
+		SnapshotStamp stamp;
+		bool stamped = SnapshotStamp::Of(path, stamp);
+		//用一条默认记录得到记录类型的列布局，与快照不符（例如字段变化）时不使用快照
+		vector<SnapshotColumnType> types;
 		{
-			T* t = new T();
-			t->FromCsvRow(line);
-			temp.push_back(t);
+			T probe;
+			SnapshotWriter layout;
+			probe.ToSnapshot(layout);
+			types = layout.Types();
 		}
-		fin.close();
+		SnapshotReader reader;
+		if (stamped && reader.Open(snapshot_path(), stamp, path, types))
+		{
+			size_t rows = reader.Rows();
+			temp.reserve(rows);
+			for (size_t i = 0; i < rows; i++) temp.push_back(new T());
+			if constexpr (has_snapshot_columns<T>::value) T::FromSnapshotColumns(reader, temp);
+			else for (size_t i = 0; i < rows; i++) temp[i]->FromSnapshot(reader, i);
+		}
+		else
+		{
+			size_t failed = sink->size();
+			temp = parse_parallel(sink, 0);
+			//解析期间csv被修改时，解析结果不一定对应开始时的状态，不写快照
+			SnapshotStamp after;
+			if (stamped && sink->size() == failed && SnapshotStamp::Of(path, after) && after.Matches(stamp, path))
+			{
+				SnapshotWriter writer;
+				for (auto i : temp)
+				{
+					i->ToSnapshot(writer);
+					writer.EndRow();
+				}
+				writer.Save(snapshot_path(), stamp, buffer);
+			}
+		}
+		apply_log(temp, sink);
+		throw_errors(temp, local);
 		return temp;
 	}
 
+	/// <summary>
+	/// 流式读取，按块读入文件并逐条解析，内存占用只与块大小有关，适合批处理超大文件。
+	/// f(T&)收到的记录在回调返回后被复用，需要保留时自行复制。f可以返回bool，返回false时停止读取。不重放增量日志
+	/// </summary>
+	/// <returns>文件完整读完时返回true，打开或读取失败、被f停止时返回false</returns>
+	/// <param name="errors">可选，输出解析失败的记录及其行号</param>
+	/// <param name="progress">可选，每读完一块调用progress(已读字节, 文件总字节)</param>
+	template<typename F>
+	bool read_stream(F f, vector<csverror>* errors = nullptr, function<void(uintmax_t, uintmax_t)> progress = nullptr)
+	{
+		ifstream fin(path, ios::binary);
+		if (!fin) return false;
+		error_code ec;
+		uintmax_t total = filesystem::file_size(path, ec);
+		if (ec) total = 0;
+		uintmax_t done = 0;
+		string data;
+		vector<char> block(flushSize);
+		T record;
+		int line = 1;
+		bool eof = false;
+		bool stopped = false;
+		while (!eof)
+		{
+			fin.read(block.data(), block.size());
+			if (fin.bad()) return false;
+			size_t got = (size_t)fin.gcount();
+			eof = got < block.size();
+			data.append(block.data(), got);
+			done += got;
+			//只处理到最后一个引号外的换行，剩余部分留给下一块
+			size_t end = data.size();
+			int lines = 0;
+			if (!eof)
+			{
+				bool quoted = false;
+				size_t last = string::npos;
+				int seen = 0;
+				for (size_t i = 0; i < data.size(); i++)
+				{
+					if (data[i] == '"') quoted = !quoted;
+					else if (data[i] == '\n')
+					{
+						seen++;
+						if (!quoted)
+						{
+							last = i;
+							lines = seen;
+						}
+					}
+				}
+				if (last == string::npos)
+				{
+					if (progress) progress(done, total);
+					continue;
+				}
+				end = last + 1;
+			}
+			each_record(data, 0, end, line, [&](int l, size_t p, size_t len)
+				{
+					if (stopped) return;
+					try
+					{
+						record.FromCsvRow(data.substr(p, len));
+					}
+					catch (const exception& e)
+					{
+						if (errors != nullptr) errors->push_back({ l,e.what() });
+						return;
+					}
+					if constexpr (is_same<decltype(f(record)), bool>::value)
+					{
+						if (!f(record)) stopped = true;
+					}
+					else f(record);
+				}, errors);
+			if (stopped) return false;
+			line += lines;
+			data.erase(0, end);
+			if (progress) progress(done, total);
+		}
+		return true;
+	}
+
+private:
+	//二进制快照文件，与csv放在一起
+	string snapshot_path() { return path + ".snap"; }
+
+	//并行解析csv本身，不重放日志
+	template<typename E = T*>
+	vector<E> parse_parallel(vector<csverror>* errors, int chunks)
+	{
+		vector<E> temp;
+		string data;
+		if (!load_all(data)) return temp;
+
+		ThreadPool& pool = ThreadPool::Shared();
+		if (chunks <= 0) chunks = pool.Size() * 4;
+		//小文件不值得切块
+		const size_t minChunk = 64 * 1024;
+		size_t n = min((size_t)chunks, data.size() / minChunk + 1);
+
+		//第一遍：并行统计每块的引号和换行数量，用前缀和得出每块起点的引号状态与行号
+		vector<size_t> bounds(n + 1);
+		for (size_t k = 0; k <= n; k++) bounds[k] = data.size() * k / n;
+		vector<size_t> quotes(n), lines(n);
+		pool.ParallelFor(n, [&](size_t k)
+			{
+				size_t q = 0, l = 0;
+				for (size_t i = bounds[k]; i < bounds[k + 1]; i++)
+				{
+					if (data[i] == '"') q++;
+					else if (data[i] == '\n') l++;
+				}
+				quotes[k] = q;
+				lines[k] = l;
+			});
+		vector<bool> quotedAt(n);
+		vector<int> lineAt(n);
+		bool quoted = false;
+		int line = 1;
+		for (size_t k = 0; k < n; k++)
+		{
+			quotedAt[k] = quoted;
+			lineAt[k] = line;
+			if (quotes[k] % 2 == 1) quoted = !quoted;
+			line += (int)lines[k];
+		}
+
+		//第二遍：并行把每块起点推进到下一条记录的开头
+		vector<size_t> starts(n + 1);
+		vector<int> startLines(n + 1);
+		starts[0] = 0;
+		startLines[0] = 1;
+		starts[n] = data.size();
+		pool.ParallelFor(n - 1, [&](size_t i)
+			{
+				size_t k = i + 1;
+				bool q = quotedAt[k];
+				size_t end = find_record_end(data, bounds[k], data.size(), q);
+				starts[k] = end == data.size() ? end : end + 1;
+				startLines[k] = lineAt[k] + (end == data.size() ? 0 : 1);
+				for (size_t j = bounds[k]; j < end; j++) if (data[j] == '\n') startLines[k]++;
+			});
+		//超长记录可能跨过整块，保证起点单调
+		for (size_t k = 1; k < n; k++)
+		{
+			if (starts[k] < starts[k - 1])
+			{
+				starts[k] = starts[k - 1];
+				startLines[k] = startLines[k - 1];
+			}
+		}
+
+		//第三遍：并行解析，再按块顺序拼接
+		vector<vector<E>> parts(n);
+		vector<vector<csverror>> partErrors(n);
+		pool.ParallelFor(n, [&](size_t k)
+			{
+				parse_chunk(data, starts[k], starts[k + 1], startLines[k], parts[k], partErrors[k]);
+			});
+		size_t total = 0;
+		for (auto& i : parts) total += i.size();
+		temp.reserve(total);
+		for (size_t k = 0; k < n; k++)
+		{
+			temp.insert(temp.end(), make_move_iterator(parts[k].begin()), make_move_iterator(parts[k].end()));
+			if (errors != nullptr) errors->insert(errors->end(), partErrors[k].begin(), partErrors[k].end());
+		}
+		return temp;
+	}
 
 };
\ No newline at end of file
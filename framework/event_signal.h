@@ -0,0 +1,282 @@
+﻿#pragma once
+#include<deque>
+#include<memory>
+#include<cstdint>
+#include<cstddef>
+#include<new>
+#include<utility>
+#include<type_traits>
+using namespace std;
+
+//可调用对象的就地存储，不超过capacity字节的可调用对象（一般的lambda）直接放在对象内，不分配内存
+template<typename... Args>
+class SmallCallback
+{
+	static const size_t capacity = 4 * sizeof(void*);
+	typedef void (*Invoke)(void*, Args...);
+	typedef void (*Destroy)(void*);
+
+	alignas(max_align_t) unsigned char storage[capacity];
+	Invoke invoke = nullptr;
+	Destroy destroy = nullptr;
+
+	template<typename F>
+	static constexpr bool fits()
+	{
+		return sizeof(F) <= capacity && alignof(F) <= alignof(max_align_t);
+	}
+public:
+	SmallCallback() {}
+	SmallCallback(const SmallCallback&) = delete;
+	SmallCallback& operator=(const SmallCallback&) = delete;
+	~SmallCallback()
+	{
+		Reset();
+	}
+
+	//保存可调用对象，之前保存的先被销毁
+	template<typename F>
+	void Assign(F&& f)
+	{
+		typedef typename decay<F>::type Fn;
+		Reset();
+		if constexpr (fits<Fn>())
+		{
+			new (storage) Fn(std::forward<F>(f));
+			invoke = [](void* p, Args... args) {(*static_cast<Fn*>(p))(args...); };
+			destroy = [](void* p) {static_cast<Fn*>(p)->~Fn(); };
+		}
+		else
+		{
+			//过大的可调用对象放到堆上，存储区只保存指针
+			*reinterpret_cast<Fn**>(storage) = new Fn(std::forward<F>(f));
+			invoke = [](void* p, Args... args) {(**static_cast<Fn**>(p))(args...); };
+			destroy = [](void* p) {delete* static_cast<Fn**>(p); };
+		}
+	}
+	//销毁保存的可调用对象
+	void Reset()
+	{
+		if (destroy != nullptr) destroy(storage);
+		invoke = nullptr;
+		destroy = nullptr;
+	}
+	bool Empty() const { return invoke == nullptr; }
+	void operator()(Args... args)
+	{
+		invoke(storage, args...);
+	}
+};
+
+//信号的公共接口，连接句柄通过它断开，不需要知道信号的参数类型
+class SignalCore
+{
+public:
+	virtual void Disconnect(uint32_t index, uint32_t generation) = 0;
+	virtual bool Connected(uint32_t index, uint32_t generation) = 0;
+	virtual ~SignalCore() {}
+};
+
+//连接句柄，Connect时返回，用于O(1)断开；信号销毁后句柄仍可安全使用
+class Connection
+{
+	weak_ptr<SignalCore> core;
+	uint32_t index = 0;
+	uint32_t generation = 0;
+public:
+	Connection() {}
+	Connection(weak_ptr<SignalCore> core, uint32_t index, uint32_t generation) : core(core), index(index), generation(generation) {}
+
+	//断开连接，重复调用无影响
+	void Disconnect()
+	{
+		if (auto c = core.lock()) c->Disconnect(index, generation);
+		core.reset();
+	}
+	//连接是否仍然有效
+	bool Connected()
+	{
+		auto c = core.lock();
+		return c != nullptr && c->Connected(index, generation);
+	}
+};
+
+/// <summary>
+/// 信号：Connect连接槽函数并返回连接句柄，Emit按连接顺序调用全部槽函数。
+/// 槽函数内可以连接、断开任意槽函数，甚至删除信号所属的对象：
+/// 本次Emit中新连接的槽函数从下一次Emit开始被调用，被断开且还未调用的槽函数本次不再调用。
+/// 槽函数就地存放在不移动的节点中，Emit本身不分配内存
+/// </summary>
+template<typename... Args>
+class Signal
+{
+	static const uint32_t none = UINT32_MAX;
+
+	//槽函数节点，按连接顺序组成双向链表，空闲节点组成单链表
+	struct Slot
+	{
+		SmallCallback<Args...> callback;
+		uint32_t generation = 0;  //节点每次被回收时递增，旧的连接句柄随之失效
+		uint32_t prev = none;
+		uint32_t next = none;
+		bool alive = false;
+		uintptr_t tag = 0;  //由调用者决定的标记，用于按标记断开
+	};
+
+	class Core : public SignalCore
+	{
+	public:
+		deque<Slot> slots;  //deque尾部追加不会移动已有节点，Emit期间连接是安全的
+		uint32_t head = none;
+		uint32_t tail = none;
+		uint32_t freeList = none;
+		size_t count = 0;  //有效连接数
+		int emitting = 0;  //Emit嵌套深度
+		bool swept = true;  //Emit期间断开的节点是否都已回收
+
+		//把节点从链表中取下并回收
+		void release(uint32_t i)
+		{
+			Slot& s = slots[i];
+			if (s.prev != none) slots[s.prev].next = s.next;
+			else head = s.next;
+			if (s.next != none) slots[s.next].prev = s.prev;
+			else tail = s.prev;
+			s.callback.Reset();
+			s.generation++;
+			s.prev = none;
+			s.next = freeList;
+			freeList = i;
+		}
+		//断开节点，Emit期间只做标记，节点在最外层Emit结束后回收
+		void kill(uint32_t i)
+		{
+			Slot& s = slots[i];
+			if (!s.alive) return;
+			s.alive = false;
+			count--;
+			if (emitting > 0) swept = false;
+			else release(i);
+		}
+		//回收Emit期间被断开的节点
+		void sweep()
+		{
+			if (swept) return;
+			swept = true;
+			for (uint32_t i = head; i != none;)
+			{
+				uint32_t next = slots[i].next;
+				if (!slots[i].alive) release(i);
+				i = next;
+			}
+		}
+		void Disconnect(uint32_t index, uint32_t generation) override
+		{
+			if (index < slots.size() && slots[index].generation == generation) kill(index);
+		}
+		bool Connected(uint32_t index, uint32_t generation) override
+		{
+			return index < slots.size() && slots[index].generation == generation && slots[index].alive;
+		}
+	};
+	shared_ptr<Core> core = make_shared<Core>();
+public:
+	Signal() {}
+	Signal(const Signal&) = delete;
+	Signal& operator=(const Signal&) = delete;
+
+	//连接槽函数，tag可用于之后按标记断开
+	template<typename F>
+	Connection Connect(F&& f, uintptr_t tag = 0)
+	{
+		Core& c = *core;
+		uint32_t i;
+		if (c.freeList != none)
+		{
+			i = c.freeList;
+			c.freeList = c.slots[i].next;
+		}
+		else
+		{
+			i = (uint32_t)c.slots.size();
+			c.slots.emplace_back();
+		}
+		Slot& s = c.slots[i];
+		s.callback.Assign(std::forward<F>(f));
+		s.alive = true;
+		s.tag = tag;
+		s.prev = c.tail;
+		s.next = none;
+		if (c.tail != none) c.slots[c.tail].next = i;
+		else c.head = i;
+		c.tail = i;
+		c.count++;
+		return Connection(core, i, s.generation);
+	}
+	//断开所有标记为tag的槽函数，返回断开的数量
+	size_t DisconnectTag(uintptr_t tag)
+	{
+		size_t n = 0;
+		for (uint32_t i = core->head; i != none;)
+		{
+			uint32_t next = core->slots[i].next;
+			if (core->slots[i].alive && core->slots[i].tag == tag)
+			{
+				core->kill(i);
+				n++;
+			}
+			i = next;
+		}
+		return n;
+	}
+	//断开按连接顺序的第n个槽函数，O(n)
+	bool DisconnectAt(size_t n)
+	{
+		for (uint32_t i = core->head; i != none; i = core->slots[i].next)
+		{
+			if (!core->slots[i].alive) continue;
+			if (n-- == 0)
+			{
+				core->kill(i);
+				return true;
+			}
+		}
+		return false;
+	}
+	//断开全部槽函数
+	void DisconnectAll()
+	{
+		for (uint32_t i = core->head; i != none;)
+		{
+			uint32_t next = core->slots[i].next;
+			core->kill(i);
+			i = next;
+		}
+	}
+	//有效连接数
+	size_t Size() { return core->count; }
+
+	//按连接顺序调用全部槽函数
+	void Emit(Args... args)
+	{
+		//槽函数可能删除信号本身，持有core直到遍历结束
+		shared_ptr<Core> hold = core;
+		Core& c = *hold;
+		if (c.head == none) return;
+		uint32_t last = c.tail;  //本次Emit开始后连接的节点排在last之后，不会被调用
+		c.emitting++;
+		for (uint32_t i = c.head; i != none;)
+		{
+			Slot& s = c.slots[i];
+			if (s.alive) s.callback(args...);
+			if (i == last) break;
+			i = s.next;
+		}
+		c.emitting--;
+		if (c.emitting == 0) c.sweep();
+	}
+	void operator()(Args... args)
+	{
+		Emit(args...);
+	}
+};
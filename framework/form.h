@@ -0,0 +1,254 @@
+﻿#pragma once
+#include<string>
+#include<vector>
+#include<memory>
+#include<functional>
+#include"framework.h"
+#include"schema.h"
+using namespace std;
+
+#pragma region 校验函数
+//数值在[lo,hi]内
+template<typename M>
+function<string(const M&)> InRange(M lo, M hi)
+{
+	return [lo, hi](const M& v) -> string
+		{
+			if (v < lo || hi < v)
+			{
+				string message = "应在";
+				SchemaCodec::Append(message, lo);
+				message += "到";
+				SchemaCodec::Append(message, hi);
+				return message + "之间";
+			}
+			return "";
+		};
+}
+//字符串不能为空
+inline function<string(const string&)> NotEmpty()
+{
+	return [](const string& v) -> string {return v.empty() ? "不能为空" : ""; };
+}
+//字符串不超过n字节
+inline function<string(const string&)> MaxLength(size_t n)
+{
+	return [n](const string& v) -> string {return v.size() > n ? "不能超过" + to_string(n) + "个字节" : ""; };
+}
+#pragma endregion
+
+/// <summary>
+/// 画布内的表单：每个输入框绑定记录类型T的一个成员，按成员类型用SchemaCodec::Parse解析，再交给该字段的校验函数。
+/// Submit一次检查全部字段，每个出错的字段在输入框右侧显示自己的错误，全部正确时才写入记录：
+/// Form&lt;Course&gt; form(&canvas, 100, 100);
+/// form.Bind("学分", &Course::credit, InRange(1, 10)).Bind("名称", &Course::name, NotEmpty());
+/// 在OnGUI里调用form.Draw()，提交时 if (form.Submit(course)) store.Insert(course);
+/// 输入框内回车跳到下一个字段，最后一个字段回车触发onSubmit
+/// </summary>
+template<typename T>
+class Form
+{
+	//一个字段的控件和解析
+	struct IField
+	{
+		string name;
+		Text* label = nullptr;
+		TextBox* box = nullptr;
+		Text* message = nullptr;  //错误提示
+		//解析并校验输入框内容，结果暂存在字段内，返回错误，空串表示正确
+		virtual string Check() = 0;
+		//把暂存的结果写入记录
+		virtual void Store(T& target) = 0;
+		//把记录的值显示到输入框
+		virtual void Load(const T& source) = 0;
+		virtual ~IField() {}
+	};
+	template<typename M>
+	struct BoundField : IField
+	{
+		M T::* member;
+		function<string(const M&)> validator;
+		M parsed{};  //Check的结果，复用同一个对象，字符串不会反复分配
+		string buffer;  //Load时格式化用
+
+		string Check() override
+		{
+			if (!SchemaCodec::Parse(string_view(this->box->GetText()), parsed)) return "格式错误";
+			if (validator) return validator(parsed);
+			return "";
+		}
+		void Store(T& target) override
+		{
+			target.*member = parsed;
+		}
+		void Load(const T& source) override
+		{
+			buffer.clear();
+			SchemaCodec::Append(buffer, source.*member);
+			this->box->SetText(buffer);
+		}
+	};
+
+	Canvas* canvas;
+	int env;  //控件注册的环境
+	int x, y;  //第一行左上角
+	vector<unique_ptr<IField>> fields;
+	vector<string> errors;  //上次Submit的错误，按字段顺序
+	shared_ptr<bool> alive = make_shared<bool>(true);  //表单是否仍存在，延迟执行的焦点切换据此跳过
+
+	//成员类型M的校验函数，M只由成员指针推导，校验函数可以直接传lambda
+	template<typename M>
+	using Validator = function<string(const typename enable_if<true, M>::type&)>;
+
+	//回车后把焦点交给下一个字段。
+	//同一条回车消息会继续分发给队列中后面的输入框，切换延迟到下一帧开始，否则一次回车会连续穿过所有字段
+	void next_focus(size_t i)
+	{
+		fields[i]->box->Blur();
+		weak_ptr<bool> guard = alive;
+		canvas->Post([this, i, guard]()
+			{
+				if (guard.expired()) return;
+				if (i + 1 < fields.size()) fields[i + 1]->box->Focus();
+				else onSubmit.Emit();
+			});
+	}
+public:
+	int labelWidth = 100;  //标签宽度
+	int boxWidth = 200;  //输入框宽度
+	int messageWidth = 240;  //错误提示宽度
+	int rowHeight = 40;  //行距
+	int boxHeight = 30;  //输入框高度
+	string fontName = "宋体";
+	COLORREF fontColor = BLACK;
+	COLORREF errorColor = RED;
+	Signal<> onSubmit;  //最后一个字段按下回车
+
+	//形参：画布，第一行左上角，控件注册的环境
+	Form(Canvas* canvas, int x, int y, int env = 0) : canvas(canvas), env(env), x(x), y(y) {}
+	~Form()
+	{
+		alive.reset();
+		int previous = canvas->GetEnv();
+		canvas->Env(env);
+		for (auto& f : fields)
+		{
+			canvas->RemoveGUI(f->label->InstanceId());
+			canvas->RemoveGUI(f->box->InstanceId());
+			canvas->RemoveGUI(f->message->InstanceId());
+			delete f->label;
+			delete f->box;
+			delete f->message;
+		}
+		canvas->Env(previous);
+	}
+	Form(const Form&) = delete;
+	Form& operator=(const Form&) = delete;
+
+#pragma region 绑定
+	//绑定成员，形参：标签，成员指针，校验函数（返回错误，空串表示正确）
+	template<typename M>
+	Form& Bind(const string& name, M T::* member, Validator<M> validator = nullptr)
+	{
+		auto field = make_unique<BoundField<M>>();
+		int top = y + (int)fields.size() * rowHeight;
+		field->name = name;
+		field->member = member;
+		field->validator = validator;
+		field->label = new Text(name, createRectbyPoint(x, top, x + labelWidth, top + boxHeight), fontName, fontColor, false);
+		field->box = new TextBox(canvas, createRectbyPoint(x + labelWidth, top, x + labelWidth + boxWidth, top + boxHeight));
+		field->box->fontName = fontName;
+		field->box->fontColor = fontColor;
+		int left = x + labelWidth + boxWidth + 10;
+		field->message = new Text("", createRectbyPoint(left, top, left + messageWidth, top + boxHeight), fontName, errorColor, false);
+		size_t i = fields.size();
+		field->box->onSubmit.Connect([this, i]() {next_focus(i); });
+		int previous = canvas->GetEnv();
+		canvas->Env(env);
+		canvas->Register(field->label->InstanceId(), field->label);
+		canvas->Register(field->box->InstanceId(), field->box);
+		canvas->Register(field->message->InstanceId(), field->message);
+		canvas->Env(previous);
+		fields.push_back(std::move(field));
+		return *this;
+	}
+	//按T::Schema()的字段表依次绑定全部字段，之后可以用Validate补充校验函数
+	Form& BindSchema()
+	{
+		apply([this](const auto&... f) {(Bind(f.name, f.member), ...); }, T::Schema());
+		return *this;
+	}
+	//设置已绑定成员的校验函数
+	template<typename M>
+	Form& Validate(M T::* member, Validator<M> validator)
+	{
+		for (auto& f : fields)
+		{
+			auto bound = dynamic_cast<BoundField<M>*>(f.get());
+			if (bound != nullptr && bound->member == member) bound->validator = validator;
+		}
+		return *this;
+	}
+	//第i个字段的输入框
+	TextBox* Box(size_t i) { return fields[i]->box; }
+	size_t Size() { return fields.size(); }
+#pragma endregion
+
+#pragma region 读写
+	//把记录显示到表单，用于修改已有记录
+	void Load(const T& source)
+	{
+		for (auto& f : fields)
+		{
+			f->Load(source);
+			f->message->SetText("");
+		}
+		errors.clear();
+	}
+	//清空全部输入框和错误，焦点回到第一个字段，用于连续录入
+	void Clear()
+	{
+		for (auto& f : fields)
+		{
+			f->box->SetText("");
+			f->box->Blur();
+			f->message->SetText("");
+		}
+		if (!fields.empty()) fields[0]->box->Focus();
+		errors.clear();
+	}
+	/// <summary>
+	/// 检查全部字段，全部正确时写入target并返回true；
+	/// 否则target不变，每个出错的字段显示自己的错误，Errors()返回全部错误
+	/// </summary>
+	bool Submit(T& target)
+	{
+		errors.clear();
+		for (auto& f : fields)
+		{
+			string error = f->Check();
+			f->message->SetText(error);
+			if (!error.empty()) errors.push_back(f->name + "：" + error);
+		}
+		if (!errors.empty()) return false;
+		for (auto& f : fields) f->Store(target);
+		return true;
+	}
+	//上次Submit的错误，按字段顺序
+	const vector<string>& Errors() { return errors; }
+#pragma endregion
+
+	//在OnGUI内调用，绘制全部字段。画布的当前环境在调用前后不变
+	void Draw()
+	{
+		int previous = canvas->GetEnv();
+		canvas->Env(env);
+		for (auto& f : fields)
+		{
+			canvas->Draw(f->label->InstanceId());
+			canvas->Draw(f->box->InstanceId());
+			canvas->Draw(f->message->InstanceId());
+		}
+		canvas->Env(previous);
+	}
+};
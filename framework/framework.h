@@ -10,6 +10,11 @@
 #include<functional>
 #include<set>
 #include <cassert>
+#include<mutex>
+#include<unordered_map>
+#include<fstream>
+#include<chrono>
+#include"event_signal.h"
 using namespace std;
 
 #pragma region 基本结构
@@ -74,14 +79,240 @@ public:
 int Object::instanceId = INT_MAX;
 set<int> Object::ids;
 
+//GUI组件的内存记录：每个存活组件的大小和创建时的标签，组件通过new创建时自动记录
+class ComponentTracker
+{
+public:
+	struct Info
+	{
+		size_t bytes;  //对象大小
+		const char* tag;  //创建时的标签，没有标签时为nullptr
+		const void* component = nullptr;  //构造时记录的GUIComponent地址，多重继承时可能不等于分配的地址，构造完成前为nullptr
+		int id = 0;  //构造时记录的实例ID
+	};
+private:
+	mutex lock;
+	unordered_map<const void*, Info> live;  //存活的组件，以分配的地址为键
+	unordered_map<const void*, const void*> byComponent;  //GUIComponent地址到分配地址
+	size_t bytes = 0;  //存活组件的大小合计
+	size_t released = 0;  //累计释放的组件数
+public:
+	//全局记录，不随静态对象析构，保证最后释放的组件也能注销
+	static ComponentTracker& Shared()
+	{
+		static ComponentTracker* tracker = new ComponentTracker();
+		return *tracker;
+	}
+	//当前线程正在使用的标签栈
+	static vector<const char*>& Tags()
+	{
+		static thread_local vector<const char*> tags;
+		return tags;
+	}
+	//当前线程最近一次分配、尚未构造出GUIComponent的地址
+	static const void*& Pending()
+	{
+		static thread_local const void* pending = nullptr;
+		return pending;
+	}
+	void Add(const void* p, size_t size)
+	{
+		auto& tags = Tags();
+		lock_guard<mutex> guard(lock);
+		live[p] = { size,tags.empty() ? nullptr : tags.back() };
+		bytes += size;
+		Pending() = p;
+	}
+	//GUIComponent构造时调用，把组件地址和实例ID关联到它所在的分配上；不是通过new创建的组件不在任何分配内，被忽略
+	void Bind(const void* component, int id)
+	{
+		const void*& pending = Pending();
+		if (pending == nullptr) return;
+		lock_guard<mutex> guard(lock);
+		auto i = live.find(pending);
+		pending = nullptr;
+		if (i == live.end() || i->second.component != nullptr) return;
+		const char* begin = (const char*)i->first;
+		const char* at = (const char*)component;
+		if (at < begin || at >= begin + i->second.bytes) return;
+		i->second.component = component;
+		i->second.id = id;
+		byComponent[component] = i->first;
+	}
+	void Remove(const void* p)
+	{
+		lock_guard<mutex> guard(lock);
+		if (Pending() == p) Pending() = nullptr;
+		auto i = live.find(p);
+		if (i == live.end()) return;
+		if (i->second.component != nullptr) byComponent.erase(i->second.component);
+		bytes -= i->second.bytes;
+		live.erase(i);
+		released++;
+	}
+	//按GUIComponent地址查询组件的记录，不是通过new创建的组件返回false
+	bool Find(const void* component, Info& info)
+	{
+		lock_guard<mutex> guard(lock);
+		auto c = byComponent.find(component);
+		if (c == byComponent.end()) return false;
+		info = live[c->second];
+		return true;
+	}
+	//存活组件数
+	size_t Count()
+	{
+		lock_guard<mutex> guard(lock);
+		return live.size();
+	}
+	//存活组件的大小合计
+	size_t Bytes()
+	{
+		lock_guard<mutex> guard(lock);
+		return bytes;
+	}
+	//累计释放的组件数，前后两次结果不同说明期间有组件被释放
+	size_t Released()
+	{
+		lock_guard<mutex> guard(lock);
+		return released;
+	}
+	//遍历全部存活组件，f(分配的地址, Info)，遍历期间不能创建或释放组件
+	template<typename F>
+	void ForEach(F f)
+	{
+		lock_guard<mutex> guard(lock);
+		for (auto& i : live) f(i.first, i.second);
+	}
+};
+
+//作用域标签：作用域内在当前线程创建的组件都记录这个标签，可以嵌套，标签需要在组件释放前一直有效（例如字符串字面量）
+//ComponentTag tag("课程录入界面");
+class ComponentTag
+{
+public:
+	ComponentTag(const char* tag)
+	{
+		ComponentTracker::Tags().push_back(tag);
+	}
+	~ComponentTag()
+	{
+		ComponentTracker::Tags().pop_back();
+	}
+	ComponentTag(const ComponentTag&) = delete;
+	ComponentTag& operator=(const ComponentTag&) = delete;
+};
+
 //GUI接口，所有GUI组件继承该接口 
 class GUIComponent :public Object
 {
 public:
+	//new创建的组件在构造时记录组件地址和实例ID，统计时不需要从分配的地址推算组件
+	GUIComponent()
+	{
+		ComponentTracker::Shared().Bind(this, InstanceId());
+	}
+	GUIComponent(const GUIComponent& other) : Object(other)
+	{
+		ComponentTracker::Shared().Bind(this, InstanceId());
+	}
 	//负责GUI渲染
 	virtual void OnGUI() = 0;
 	//负责消息处理与事件响应
 	virtual void OnEvent(ExMessage* message) = 0;
+	//由本组件负责释放的子组件，用于内存统计
+	virtual void Children(vector<GUIComponent*>& out) {}
+	//把组件放到新的矩形内，由布局调用，不支持移动的组件忽略
+	virtual void Arrange(Rect rct) {}
+	//通过基类指针释放组件时调用派生类的析构
+	virtual ~GUIComponent() {}
+
+	//new创建的组件记录到ComponentTracker
+	static void* operator new(size_t size)
+	{
+		void* p = ::operator new(size);
+		ComponentTracker::Shared().Add(p, size);
+		return p;
+	}
+	static void operator delete(void* p)
+	{
+		ComponentTracker::Shared().Remove(p);
+		::operator delete(p);
+	}
+};
+
+//一组组件的数量和大小，包括它们的子组件
+struct ComponentUsage
+{
+	size_t count = 0;
+	size_t bytes = 0;
+};
+//一个组件的内存记录
+struct ComponentRecord
+{
+	int id;  //实例ID
+	size_t bytes;
+	const char* tag;  //创建时的标签，可能为nullptr
+};
+//Canvas::Report的结果
+struct ComponentReport
+{
+	ComponentUsage registered[4];  //各环境中注册的组件
+	ComponentUsage collected[4];  //各环境中Collect的组件
+	ComponentUsage live;  //全部存活组件
+	vector<ComponentRecord> unreachable;  //存活但不在任何环境或Collection中、也不是它们子组件的组件，通常是泄漏
+	//按标签汇总的文本，便于输出到控制台
+	string ToString()
+	{
+		string out;
+		for (int i = 0; i < 4; i++)
+		{
+			out += "环境" + to_string(i) + "：注册" + to_string(registered[i].count) + "个 " + to_string(registered[i].bytes) + "字节，";
+			out += "Collection " + to_string(collected[i].count) + "个 " + to_string(collected[i].bytes) + "字节\n";
+		}
+		out += "存活组件" + to_string(live.count) + "个 " + to_string(live.bytes) + "字节，不可达" + to_string(unreachable.size()) + "个\n";
+		map<string, ComponentUsage> byTag;
+		for (auto& r : unreachable)
+		{
+			auto& u = byTag[r.tag != nullptr ? r.tag : "未标记"];
+			u.count++;
+			u.bytes += r.bytes;
+		}
+		for (auto& i : byTag) out += "  " + i.first + "：" + to_string(i.second.count) + "个 " + to_string(i.second.bytes) + "字节\n";
+		return out;
+	}
+};
+
+//投递到画布线程的函数队列，由画布和后台任务共同持有。
+//后台任务持有它而不是画布指针，画布析构后关闭队列，迟到的投递被丢弃
+class PostBox
+{
+	mutex lock;
+	bool closed = false;
+	vector<function<void(void)>> posted;
+public:
+	//加入队列，队列已关闭时返回false
+	bool Post(function<void(void)> func)
+	{
+		lock_guard<mutex> guard(lock);
+		if (closed) return false;
+		posted.push_back(std::move(func));
+		return true;
+	}
+	//取出全部待执行的函数
+	void Take(vector<function<void(void)>>& out)
+	{
+		lock_guard<mutex> guard(lock);
+		out.swap(posted);
+	}
+	//关闭队列并丢弃未执行的函数
+	void Close()
+	{
+		vector<function<void(void)>> dropped;
+		lock_guard<mutex> guard(lock);
+		closed = true;
+		dropped.swap(posted);
+	}
 };
 
 //画布类，负责画布生命维护，不实现具体逻辑
@@ -97,7 +328,8 @@ private:
 	bool life = true;//是否存活
 	int deltaTime;//上一帧消耗的时间 ms
 	COLORREF bgc;//背景色
-	ExMessage message;//消息临时内存
+	vector<ExMessage> inbox;//本帧待分发的消息
+	vector<GUIComponent*> dispatching;//分发消息时本帧的消息队列
 	HWND window;//窗口句柄
 #pragma endregion
 #pragma region 环境与队列
@@ -121,6 +353,108 @@ private:
 
 	//当前环境ID
 	int envid = 0;
+
+	//投递到画布线程的函数，其他线程通过Post写入
+	shared_ptr<PostBox> postBox = make_shared<PostBox>();
+	vector<function<void(void)>> running;
+
+	//定时器，按(到期时间, id)排序
+	map<pair<int, int>, function<void(void)>> timers;
+	int nextTimer = 0;
+#pragma endregion
+#pragma region 录制与回放
+	//录制文件：文件头之后每帧一条记录，varint(帧时间增量<<1|是否有消息)，有消息时跟着varint(消息数)和各条ExMessage的原始字节
+	static constexpr char inputMagic[4] = { 'Y','N','G','2' };
+	ofstream recordFile;  //正在录制时打开
+	ifstream replayFile;  //正在回放时打开
+	ofstream timingFile;  //每帧耗时输出
+	int frameIndex = 0;  //已开始的帧数
+	int lastTime = 0;  //上一帧的帧时间，用于录制和回放增量
+	vector<ExMessage> replayed;  //回放中本帧的消息
+
+	static void write_varint(ostream& out, uint32_t v)
+	{
+		while (v >= 0x80)
+		{
+			out.put((char)(v | 0x80));
+			v >>= 7;
+		}
+		out.put((char)v);
+	}
+	static bool read_varint(istream& in, uint32_t& v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 35; shift += 7)
+		{
+			int c = in.get();
+			if (c == EOF) return false;
+			v |= (uint32_t)(c & 0x7F) << shift;
+			if ((c & 0x80) == 0) return true;
+		}
+		return false;
+	}
+	//文件头：标识，ExMessage大小，画布宽高，不一致的录制不能回放
+	void write_header(ostream& out)
+	{
+		int32_t head[3] = { (int32_t)sizeof(ExMessage),width,height };
+		out.write(inputMagic, 4);
+		out.write((const char*)head, sizeof(head));
+	}
+	bool check_header(istream& in)
+	{
+		char magic[4];
+		int32_t head[3];
+		in.read(magic, 4);
+		in.read((char*)head, sizeof(head));
+		return in && memcmp(magic, inputMagic, 4) == 0 && head[0] == (int32_t)sizeof(ExMessage) && head[1] == width && head[2] == height;
+	}
+	//帧开始：回放时读出本帧的虚拟时间和消息，录制结束时返回false
+	bool begin_frame()
+	{
+		frameIndex++;
+		if (!replayFile.is_open())
+		{
+			frameStart = GetTickCount();
+			//录制从第一帧开始计时
+			if (frameIndex == 1) lastTime = frameStart;
+			return true;
+		}
+		uint32_t v;
+		if (!read_varint(replayFile, v)) return false;
+		frameStart = lastTime + (int)(v >> 1);
+		lastTime = frameStart;
+		replayed.clear();
+		if (v & 1)
+		{
+			uint32_t count;
+			if (!read_varint(replayFile, count)) return false;
+			replayed.resize(count);
+			if (!replayFile.read((char*)replayed.data(), count * sizeof(ExMessage))) return false;
+		}
+		return true;
+	}
+	//取出本帧到达的全部消息追加到inbox，回放时来自录制文件，录制时写入本帧记录
+	void read_messages()
+	{
+		size_t first = inbox.size();
+		if (replayFile.is_open()) inbox.insert(inbox.end(), replayed.begin(), replayed.end());
+		else
+		{
+			ExMessage msg;
+			while (peekmessage(&msg)) inbox.push_back(msg);
+		}
+		if (recordFile.is_open())
+		{
+			size_t count = inbox.size() - first;
+			write_varint(recordFile, (uint32_t)(frameStart - lastTime) << 1 | (count > 0 ? 1 : 0));
+			if (count > 0)
+			{
+				write_varint(recordFile, (uint32_t)count);
+				recordFile.write((const char*)&inbox[first], count * sizeof(ExMessage));
+			}
+			lastTime = frameStart;
+		}
+	}
 #pragma endregion
 #pragma region 队列化GUI处理
 	//渲染GUI并清空队列
@@ -133,13 +467,59 @@ private:
 		}
 	}
 	//处理GUI消息并清空队列
-	void BroadcastAll(ExMessage* message)
+	//按到达顺序把inbox中的消息逐条分发给本帧消息队列中的全部组件。
+	//某个组件处理消息时释放了组件，队列中可能留有悬空指针：这条消息不再分发给队列中余下的组件，
+	//剩余消息留到下一帧按新的队列分发
+	void BroadcastAll()
 	{
+		dispatching.clear();
 		while (!eventQueue.empty())
 		{
-			eventQueue.front()->OnEvent(message);
+			dispatching.push_back(eventQueue.front());
 			eventQueue.pop();
 		}
+		size_t released = ComponentTracker::Shared().Released();
+		size_t done = 0;
+		bool stale = false;
+		while (done < inbox.size() && !stale)
+		{
+			for (auto i : dispatching)
+			{
+				i->OnEvent(&inbox[done]);
+				if (ComponentTracker::Shared().Released() != released)
+				{
+					stale = true;
+					break;
+				}
+			}
+			done++;
+		}
+		inbox.erase(inbox.begin(), inbox.begin() + done);
+	}
+	//执行投递到画布线程的函数，执行期间新投递的函数留到下一帧
+	void RunPosted()
+	{
+		postBox->Take(running);
+		for (auto& i : running) i();
+		running.clear();
+	}
+	//执行到期的定时器，执行期间新设置的定时器最早在下一帧执行
+	void RunTimers()
+	{
+		int limit = nextTimer;
+		for (auto i = timers.begin(); i != timers.end() && i->first.first <= frameStart;)
+		{
+			if (i->first.second >= limit)
+			{
+				i++;
+				continue;
+			}
+			function<void(void)> func = std::move(i->second);
+			i = timers.erase(i);
+			func();
+			//回调可能修改了定时器表
+			i = timers.begin();
+		}
 	}
 #pragma endregion
 protected:
@@ -169,6 +549,12 @@ public:
 	int FrameCount() { return fps; }
 	//上一帧的时间，ms单位
 	int DeltaTime() { return deltaTime; }
+	//当前帧开始的时间，ms单位，同一帧内不变，用于动画和闪烁；回放时为录制的虚拟时间
+	int Time() { return frameStart; }
+	//已开始的帧数
+	int Frame() { return frameIndex; }
+	//是否正在回放
+	bool Replaying() { return replayFile.is_open(); }
 	HWND* Window()
 	{
 		return &window;
@@ -189,6 +575,11 @@ public:
 
 		
 	}
+	//关闭投递队列，之后后台任务的投递被丢弃
+	~Canvas()
+	{
+		postBox->Close();
+	}
 #pragma endregion
 
 #pragma region GUI操作
@@ -199,6 +590,8 @@ public:
 		envid = env;
 		return *this;
 	}
+	//当前环境ID
+	int GetEnv() { return envid; }
 	//渲染某个已注册GUI
 	void Draw(int id)
 	{
@@ -236,9 +629,35 @@ public:
 	{
 		cenvs[envid].push_back(gui1);
 		if (gui2 != nullptr) cenvs[envid].push_back(gui2);
-		else if (gui3 != nullptr) cenvs[envid].push_back(gui3);
-		else if (gui4 != nullptr) cenvs[envid].push_back(gui4);
+		if (gui3 != nullptr) cenvs[envid].push_back(gui3);
+		if (gui4 != nullptr) cenvs[envid].push_back(gui4);
 	}
+	//ms毫秒后在帧开始时执行，按帧时间计时，回放时使用录制的虚拟时间；只能在画布线程调用，返回的id用于ClearTimeout
+	int SetTimeout(int ms, function<void(void)> func)
+	{
+		int id = nextTimer++;
+		timers.insert({ { frameStart + ms,id },std::move(func) });
+		return id;
+	}
+	//取消未执行的定时器
+	void ClearTimeout(int id)
+	{
+		for (auto i = timers.begin(); i != timers.end(); i++)
+		{
+			if (i->first.second == id)
+			{
+				timers.erase(i);
+				return;
+			}
+		}
+	}
+	//把函数投递到画布线程，在下一帧开始时执行，可以从任意线程调用
+	void Post(function<void(void)> func)
+	{
+		postBox->Post(std::move(func));
+	}
+	//投递队列，可能在画布析构后才完成的后台任务持有它代替画布指针
+	shared_ptr<PostBox> Mailbox() { return postBox; }
 #pragma endregion
 
 #pragma region 批量释放资源
@@ -286,6 +705,90 @@ public:
 
 #pragma endregion
 
+#pragma region 内存统计
+	/// <summary>
+	/// 统计各环境注册和Collect的组件（包括子组件）的数量与大小，并找出存活但不可达的组件。
+	/// 只统计通过new创建的组件；Register和Collect都不复制组件，ReleaseGUI、ReleaseAll释放内存，RemoveGUI、RemoveAll只解除注册，
+	/// 解除注册后没有再释放的组件会出现在unreachable中
+	/// </summary>
+	ComponentReport Report()
+	{
+		ComponentReport report;
+		set<const void*> reached;
+		vector<GUIComponent*> stack;
+		//统计一组组件及其子组件，同一组内重复出现的组件只计一次
+		auto measure = [&](ComponentUsage& usage, auto begin, auto end, auto get)
+			{
+				set<const void*> seen;
+				for (auto i = begin; i != end; i++) stack.push_back(get(*i));
+				while (!stack.empty())
+				{
+					GUIComponent* gui = stack.back();
+					stack.pop_back();
+					if (gui == nullptr || !seen.insert(gui).second) continue;
+					reached.insert(gui);
+					ComponentTracker::Info info;
+					if (ComponentTracker::Shared().Find(gui, info))
+					{
+						usage.count++;
+						usage.bytes += info.bytes;
+					}
+					gui->Children(stack);
+				}
+			};
+		for (int i = 0; i < 4; i++)
+		{
+			measure(report.registered[i], envs[i].begin(), envs[i].end(), [](pair<const int, GUIComponent*>& p) {return p.second; });
+			measure(report.collected[i], cenvs[i].begin(), cenvs[i].end(), [](GUIComponent* p) {return p; });
+		}
+		ComponentTracker::Shared().ForEach([&](const void* p, const ComponentTracker::Info& info)
+			{
+				report.live.count++;
+				report.live.bytes += info.bytes;
+				//尚未构造完成的组件没有组件地址，不判断是否可达
+				if (info.component != nullptr && reached.count(info.component) == 0)
+					report.unreachable.push_back({ info.id,info.bytes,info.tag });
+			});
+		return report;
+	}
+#pragma endregion
+
+#pragma region 录制与回放
+	/// <summary>
+	/// 在Show之前调用，把每帧的帧时间和收到的消息录制到文件。
+	/// 录制文件交给Replay可以逐帧重现同一次操作，用于复现卡顿和性能回归测试
+	/// </summary>
+	bool Record(const string& path)
+	{
+		recordFile.open(path, ios::binary | ios::trunc);
+		if (!recordFile) return false;
+		write_header(recordFile);
+		return true;
+	}
+	/// <summary>
+	/// 在Show之前调用，回放录制文件：帧时间换成录制的虚拟时间，消息来自文件而不是窗口，帧之间不等待。
+	/// 文件读完时画布关闭。后台任务的完成时机不在录制范围内，需要确定性的场景应避免依赖后台任务
+	/// </summary>
+	bool Replay(const string& path)
+	{
+		replayFile.open(path, ios::binary);
+		if (!replayFile || !check_header(replayFile))
+		{
+			replayFile.close();
+			return false;
+		}
+		return true;
+	}
+	//在Show之前调用，把每帧的实际耗时写入csv：帧序号,帧时间ms,耗时us
+	bool RecordFrameTiming(const string& path)
+	{
+		timingFile.open(path, ios::trunc);
+		if (!timingFile) return false;
+		timingFile << "frame,time,us\n";
+		return true;
+	}
+#pragma endregion
+
 #pragma region 生命周期干涉操作
 	//画布初始化
 	void Show(void start(Canvas& canvas), void update(Canvas& canvas), void ongui(Canvas& canvas),bool showConsole=false)
@@ -308,8 +811,12 @@ public:
 
 		while (life && IsWindow(window))
 		{
-			//帧开始计时
-			frameStart = GetTickCount();
+			//帧开始计时，回放结束时退出
+			auto realStart = chrono::steady_clock::now();
+			if (!begin_frame()) break;
+			//执行后台任务投递回来的函数和到期的定时器
+			RunPosted();
+			RunTimers();
 			//渲染与消息队列（将生命周期GUI和持久化渲染GUI添加到渲染队列和消息队列）
 			OnGUI(*this);
 
@@ -319,21 +826,20 @@ public:
 			RenderAll();
 			EndBatchDraw();
 
-			//生命周期--消息分发
-			if (peekmessage(&message))
-			{
-				BroadcastAll(&message);
-				message = {};
-			}
+			//生命周期--消息分发，本帧到达的消息全部分发，不会每帧只处理一条
+			read_messages();
+			if (!inbox.empty()) BroadcastAll();
 			else while (!eventQueue.empty()) eventQueue.pop();
 
 
 			//生命周期--帧更新
 			OnUpdate(*this);
 
-			//帧数控制
-			deltaTime = GetTickCount() - frameStart;
-			if (frameTime - deltaTime > 0)
+			//帧数控制，回放时不等待
+			auto used = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - realStart).count();
+			deltaTime = (int)(used / 1000);
+			if (timingFile.is_open()) timingFile << frameIndex << ',' << frameStart << ',' << used << '\n';
+			if (!replayFile.is_open() && frameTime - deltaTime > 0)
 			{
 				Sleep(frameTime - deltaTime);
 			}
@@ -341,6 +847,9 @@ public:
 			//cout << "Frame:" << count++ << "  " << "FrameTime:" << frameTime << "  " << "DeltaTime:" << deltaTime<<"  SleepTime:"<< frameTime - deltaTime << endl;
 		}
 		closegraph();
+		recordFile.close();
+		replayFile.close();
+		timingFile.close();
 	}
 	//关闭画布
 	void Close()
@@ -440,6 +949,12 @@ public:
 		color = c;
 		temp = createRectbyCenter(rect.center, rect.width + s, rect.height + s);
 	}
+	void Arrange(Rect rct) override
+	{
+		int s = temp.width - rect.width;
+		rect = rct;
+		temp = createRectbyCenter(rect.center, rect.width + s, rect.height + s);
+	}
 };
 //允许加载纯色和图片的矩形
 class Image : public GUIComponent
@@ -473,6 +988,11 @@ public:
 		rect = rct;
 		color = c;
 	}
+	//图片按加载时的大小绘制，只移动位置
+	void Arrange(Rect rct) override
+	{
+		rect = rct;
+	}
 	
 
 };
@@ -519,6 +1039,11 @@ public:
 		center = hcenter;
 		rr = { rect.origin.x,rect.origin.y,rect.end.x,rect.end.y };
 	}
+	void Arrange(Rect rct) override
+	{
+		rect = rct;
+		rr = { rect.origin.x,rect.origin.y,rect.end.x,rect.end.y };
+	}
 };
 //能点击的按钮
 class Button : public GUIComponent
@@ -526,8 +1051,8 @@ class Button : public GUIComponent
 	Image* a = nullptr;  //按钮的图片指针
 	Text* t = nullptr;  //按钮文字指针
 	LineBox* box = nullptr;  //按钮线框指针
-	vector<function<void(void)>> onclicks;  //消息列表
 public:
+	Signal<> onClick;  //点击信号，槽函数内可以安全地添加、移除监听
 	void OnGUI() override
 	{
 		//分别调用子对象的渲染函数
@@ -545,37 +1070,37 @@ public:
 		//处理按下消息
 		if (a!=NULL&&message->message==WM_LBUTTONDOWN&& inRect(message->x, message->y, &(a->rect)))
 		{	
-			for (auto& i : onclicks) i();
+			onClick.Emit();
 		}
 	}
 
 
-	//添加监听事件
-	void AddListener(function<void(void)> onclick)
+	//添加监听事件，返回的连接句柄可用于移除
+	template<typename F>
+	Connection AddListener(F onclick)
+	{
+		return onClick.Connect(std::move(onclick));
+	}
+	//添加普通函数作为监听事件，之后可以按函数移除
+	Connection AddListener(void (*onclick)(void))
 	{
-		onclicks.push_back(onclick);
+		return onClick.Connect(onclick, reinterpret_cast<uintptr_t>(onclick));
 	}
-	//移除监听事件，效率较低
+	//移除以普通函数添加的监听事件，lambda无法比较，用AddListener返回的连接句柄移除
 	void RemoveListener(function<void(void)> onclick)
 	{
-		for (auto i = onclicks.begin(); i != onclicks.end(); i++)
-		{
-			bool eq = *(onclick.target<void(*)(void)>()) == *(i->target<void(*)(void)>());
-			if (eq)
-			{
-				onclicks.erase(i);
-			}
-		}
+		auto f = onclick.target<void(*)(void)>();
+		if (f != nullptr && *f != nullptr) onClick.DisconnectTag(reinterpret_cast<uintptr_t>(*f));
 	}
-	//根据id移除监听
+	//按添加顺序的第id个监听移除
 	void RemoveListener(int id)
 	{
-		onclicks.erase(onclicks.begin() + id);
+		onClick.DisconnectAt(id);
 	}
 	//移除全部监听
 	void RemoveAllListener()
 	{
-		onclicks.clear();
+		onClick.DisconnectAll();
 	}
 	//形参：图片指针，文本指针，线框指针，点击范围以图片指针范围为准
 	Button(Image* img, Text* txt = nullptr, LineBox* edge = nullptr)
@@ -586,12 +1111,21 @@ public:
 	}
 	Button(Rect rct,COLORREF imgColor, string txt, COLORREF fColor, COLORREF edgeColor)
 	{
-		Image* img = new Image(rct, imgColor);
-		Text* t = new Text(txt, rct,"宋体",fColor, true);
-		LineBox* lb = new LineBox(rct, edgeColor);
-		a = img;
-		t = t;
-		box = lb;
+		a = new Image(rct, imgColor);
+		t = new Text(txt, rct, "宋体", fColor, true);
+		box = new LineBox(rct, edgeColor);
+	}
+	void Children(vector<GUIComponent*>& out) override
+	{
+		if (a != nullptr) out.push_back(a);
+		if (t != nullptr) out.push_back(t);
+		if (box != nullptr) out.push_back(box);
+	}
+	void Arrange(Rect rct) override
+	{
+		if (a != nullptr) a->Arrange(rct);
+		if (t != nullptr) t->Arrange(rct);
+		if (box != nullptr) box->Arrange(rct);
 	}
 	~Button()
 	{
@@ -665,12 +1199,25 @@ public:
 	}
 	~Gird()
 	{
-		for (int x = 0; x < xCount; x++)for (int y = 0; y < yCount; y++) delete units[x][y];
-		for (int i = 0; i < xCount; i++)
+		//units按[行][列]分配
+		for (int y = 0; y < yCount; y++)
 		{
-			delete(units[i]);
+			for (int x = 0; x < xCount; x++) delete units[y][x];
+			delete[] units[y];
 		}
-		delete units;
+		delete[] units;
+	}
+	void Children(vector<GUIComponent*>& out) override
+	{
+		for (int y = 0; y < yCount; y++)for (int x = 0; x < xCount; x++) out.push_back(units[y][x]);
+	}
+	//行列数不变，单元格按新范围均分
+	void Arrange(Rect rct) override
+	{
+		rect = rct;
+		unitRect = createRectbyPoint(0, 0, rct.width / xCount, rct.height / yCount);
+		for (int y = 0; y < yCount; y++)for (int x = 0; x < xCount; x++)
+			units[y][x]->Arrange(moveRect({ rect.origin.x + x * unitRect.width,rect.origin.y + unitRect.height * y }, unitRect));
 	}
 	//仅在GUI渲染时回调
 	void OnGUI() override
@@ -727,42 +1274,85 @@ class GirdList : public GUIComponent
 	Gird* gird;
 	COLORREF fontColor;
 	int rowCount, columnCount;
-	vector<T*>* origin;
-	
+	function<int(void)> countOf;  //数据源记录数
+	function<T*(int)> itemAt;  //数据源第i条记录
+	bool observed = false;  //数据源是否会通知变化，否则每帧重新读取整页
+	vector<char> stale;  //当前页的每一行是否需要重新读取
+	vector<Connection> connections;  //对可观察数据源的订阅
 	
 	int currentPage = 0;
 
+	//最后一页的下标，没有数据时为0
 	int getMaxPage()
 	{
-		auto x = origin;
-		int count = origin->size();
+		int count = countOf ? countOf() : 0;
 		int per = rowCount - 1;
-		return count / per + 1;
+		return count == 0 ? 0 : (count - 1) / per;
 	}
 
 	function<vector<string>(T*)> handle;
+
+	//整页重新读取
+	void invalidate_all()
+	{
+		stale.assign(max(rowCount - 1, 0), 1);
+	}
+	//第first到第last条记录变化，只标记当前页内受影响的行
+	void invalidate_range(size_t first, size_t last)
+	{
+		size_t per = stale.size();
+		size_t from = (size_t)currentPage * per;
+		if (last < from || first >= from + per) return;
+		for (size_t i = max(first, from); i <= min(last, from + per - 1); i++) stale[i - from] = 1;
+	}
+	//插入或删除后页数可能减少
+	void clamp_page()
+	{
+		int maxpg = getMaxPage();
+		if (currentPage > maxpg)
+		{
+			currentPage = maxpg;
+			invalidate_all();
+		}
+	}
+	void unbind()
+	{
+		for (auto& c : connections) c.Disconnect();
+		connections.clear();
+		observed = false;
+	}
 	
 public: 
 	void next_page()
 	{
 		int maxpg = this->getMaxPage();
-		currentPage = min(currentPage+1, maxpg);
+		SetPage(min(currentPage+1, maxpg));
 	}
 	void last_page()
 	{
-		currentPage = max(currentPage-1, 0);
+		SetPage(max(currentPage-1, 0));
 	}
 
 	void top_page()
 	{
-		int maxpg = getMaxPage();
-		currentPage = min(0, maxpg);
+		SetPage(0);
 	}
 	void end_page()
 	{
-		int maxpg = getMaxPage();
-		currentPage = min(maxpg, maxpg);
+		SetPage(getMaxPage());
+	}
+	//跳到第page页，从0开始
+	void SetPage(int page)
+	{
+		page = max(0, min(page, getMaxPage()));
+		if (page == currentPage) return;
+		currentPage = page;
+		invalidate_all();
 	}
+	//当前页下标
+	int Page() { return currentPage; }
+	//总页数，没有数据时为1
+	int PageCount() { return getMaxPage() + 1; }
 
 
 	GirdList(int rowCount, int columnCount,Vector2 lefttop, int width, int height,
@@ -771,17 +1361,61 @@ public:
 		fontColor(fontColor),columnCount(columnCount),rowCount(rowCount)
 	{
 		gird = new Gird(lefttop, columnCount, rowCount, width, height, line_color,font,fontColor);
-
+		invalidate_all();
 	}
 
 	~GirdList()
 	{
+		unbind();
 		delete gird;
 	}
+	void Children(vector<GUIComponent*>& out) override
+	{
+		out.push_back(gird);
+	}
+	void Arrange(Rect rct) override
+	{
+		gird->Arrange(rct);
+	}
 
+	//绑定vector，不知道何时变化，每帧重新读取整页
 	void SetOrigin(vector<T*>* origin)
 	{
-		this->origin = origin;
+		unbind();
+		countOf = [origin]() {return (int)origin->size(); };
+		itemAt = [origin](int i) {return (*origin)[i]; };
+		invalidate_all();
+	}
+	//绑定任意提供Size()和At(i)的数据源，例如RecordStore，每帧重新读取整页
+	template<typename Source>
+	void SetSource(Source* source)
+	{
+		unbind();
+		countOf = [source]() {return (int)source->Size(); };
+		itemAt = [source](int i) {return source->At(i); };
+		invalidate_all();
+	}
+	//绑定可观察的数据源，例如ObservableList，只在收到变化通知时重新读取受影响的行。
+	//数据源需要提供Size()、At(i)和onInsert、onErase、onUpdate、onMove、onReset信号
+	template<typename Source>
+	void Bind(Source* source)
+	{
+		SetSource(source);
+		observed = true;
+		//插入、删除使其后的行整体移动
+		connections.push_back(source->onInsert.Connect([this](size_t i, size_t) {invalidate_range(i, SIZE_MAX); }));
+		connections.push_back(source->onErase.Connect([this](size_t i, size_t)
+			{
+				clamp_page();
+				invalidate_range(i, SIZE_MAX);
+			}));
+		connections.push_back(source->onUpdate.Connect([this](size_t i) {invalidate_range(i, i); }));
+		connections.push_back(source->onMove.Connect([this](size_t from, size_t to) {invalidate_range(min(from, to), max(from, to)); }));
+		connections.push_back(source->onReset.Connect([this]()
+			{
+				clamp_page();
+				invalidate_all();
+			}));
 	}
 	void SetHeader(vector<string> head)
 	{
@@ -798,6 +1432,7 @@ public:
 	void SetColumn(function<vector<string>(T*)> hd)
 	{
 		handle = hd;
+		invalidate_all();
 	}
 
 	void OnGUI() override
@@ -808,10 +1443,14 @@ public:
 		int from = currentPage * per;
 		//遍历终点
 		int to = from + per;
-		//从1 - rowcount遍历行
+		//从1 - rowcount遍历行，还没有设置数据源或列时按空表绘制
+		int count = countOf && handle ? countOf() : 0;
 		for (int i = 1; i < rowCount; i++)
 		{
-			if (from+i-1>= (*origin).size())
+			//可观察的数据源只重新读取变化过的行
+			if (observed && !stale[i - 1]) continue;
+			stale[i - 1] = 0;
+			if (from+i-1>= count)
 			{
 				for (int j = 0; j < columnCount; j++)
 				{
@@ -820,7 +1459,7 @@ public:
 			}
 			else
 			{
-				vector<string> head = handle((*origin)[from+i-1]);
+				vector<string> head = handle(itemAt(from+i-1));
 				for (int j = 0; j < head.size(); j++)
 				{
 					gird->SetUnit(i, j, (head)[j], fontColor);
@@ -837,155 +1476,209 @@ public:
 	}
 };
 
-#pragma region MyRegion
-
-
-
-/*
-// 实现文本框控件
-class EasyTextBox
+//单行文本输入框，接入画布的消息分发，不阻塞画布循环。
+//点击获得焦点，点击框外失去焦点；支持多字符集下输入法逐字节发来的双字节字符
+class TextBox : public GUIComponent
 {
-private:
-	int left = 0, top = 0, right = 0, bottom = 0;	// 控件坐标
-	wchar_t* text = NULL;							// 控件内容
-	size_t maxlen = 0;									// 文本框最大内容长度
-
+	Canvas* canvas;  //用于读取帧时间，驱动光标闪烁
+	string text;  //内容，多字符集编码
+	size_t caret = 0;  //光标位置，字节下标，总在字符边界上
+	char lead = 0;  //等待尾字节的双字节字符首字节
+	bool measured = false;  //caretX是否与当前内容和光标一致
+	int caretX = 0;  //光标前文字的宽度缓存，内容或光标变化后在下一次渲染时重新测量
+	int editTime = 0;  //上次编辑的帧时间，编辑后光标立即显示
+	RECT rr;  //系统使用的矩形
+
+	//pos之前一个字符的起点
+	size_t prev_char(size_t pos)
+	{
+		size_t i = 0, last = 0;
+		while (i < pos)
+		{
+			last = i;
+			i += IsDBCSLeadByte((BYTE)text[i]) && i + 1 < text.size() ? 2 : 1;
+		}
+		return last;
+	}
+	//pos之后一个字符的起点
+	size_t next_char(size_t pos)
+	{
+		if (pos >= text.size()) return text.size();
+		return min(text.size(), pos + (IsDBCSLeadByte((BYTE)text[pos]) ? 2 : 1));
+	}
+	//内容或光标变化
+	void changed(bool content)
+	{
+		measured = false;
+		editTime = canvas->Time();
+		if (content) onChange.Emit();
+	}
+	//在光标处插入字节序列
+	void insert(const char* bytes, size_t n)
+	{
+		if (text.size() + n > maxLength) return;
+		text.insert(caret, bytes, n);
+		caret += n;
+		changed(true);
+	}
+	void on_char(TCHAR c)
+	{
+		BYTE ch = (BYTE)c;
+		if (lead != 0)
+		{
+			char pair[2] = { lead, (char)ch };
+			lead = 0;
+			insert(pair, 2);
+			return;
+		}
+		if (IsDBCSLeadByte(ch))
+		{
+			lead = (char)ch;
+			return;
+		}
+		switch (ch)
+		{
+		case '\b':
+			if (caret > 0)
+			{
+				size_t from = prev_char(caret);
+				text.erase(from, caret - from);
+				caret = from;
+				changed(true);
+			}
+			break;
+		case '\r':
+		case '\n':
+			onSubmit.Emit();
+			break;
+		default:
+			//其他控制字符不输入
+			if (ch >= 32)
+			{
+				char one = (char)ch;
+				insert(&one, 1);
+			}
+		}
+	}
+	void on_key(BYTE vk)
+	{
+		switch (vk)
+		{
+		case VK_LEFT:
+			if (caret > 0) caret = prev_char(caret), changed(false);
+			break;
+		case VK_RIGHT:
+			if (caret < text.size()) caret = next_char(caret), changed(false);
+			break;
+		case VK_HOME:
+			caret = 0;
+			changed(false);
+			break;
+		case VK_END:
+			caret = text.size();
+			changed(false);
+			break;
+		case VK_DELETE:
+			if (caret < text.size())
+			{
+				text.erase(caret, next_char(caret) - caret);
+				changed(true);
+			}
+			break;
+		}
+	}
 public:
-	void Create(int x1, int y1, int x2, int y2, int max)
+	Rect rect;  //输入框范围
+	bool focused = false;  //是否正在输入
+	size_t maxLength = 256;  //最大字节数
+	string hint;  //内容为空且没有焦点时显示的提示
+	string fontName = "宋体";
+	COLORREF fontColor = BLACK;
+	COLORREF hintColor = LIGHTGRAY;
+	COLORREF backColor = WHITE;
+	COLORREF edgeColor = LIGHTGRAY;  //没有焦点时的线框颜色
+	COLORREF focusColor = BLACK;  //有焦点时的线框颜色
+	int padding = 5;  //文字与左边框的距离
+	Signal<> onChange;  //内容变化
+	Signal<> onSubmit;  //按下回车
+
+	//形参：画布，范围，没有内容时的提示
+	TextBox(Canvas* canvas, Rect rct, string hint = "") : canvas(canvas), hint(hint)
 	{
-		maxlen = max;
-		text = new wchar_t[maxlen];
-		text[0] = 0;
-		left = x1, top = y1, right = x2, bottom = y2;
-
-		// 绘制用户界面
-		Show();
+		rect = rct;
+		rr = { rect.origin.x + padding,rect.origin.y,rect.end.x - padding,rect.end.y };
 	}
 
-	~EasyTextBox()
+	const string& GetText() { return text; }
+	//设置内容，光标移到末尾
+	void SetText(string str)
 	{
-		if (text != NULL)
-			delete[] text;
+		text = str.size() > maxLength ? str.substr(0, maxLength) : str;
+		caret = text.size();
+		lead = 0;
+		changed(true);
 	}
-
-	wchar_t* Text()
+	void Focus()
 	{
-		return text;
+		focused = true;
+		changed(false);
 	}
-
-	bool Check(int x, int y)
+	void Arrange(Rect rct) override
 	{
-		return (left <= x && x <= right && top <= y && y <= bottom);
+		rect = rct;
+		rr = { rect.origin.x + padding,rect.origin.y,rect.end.x - padding,rect.end.y };
 	}
-
-	// 绘制界面
-	void Show()
+	void Blur()
 	{
-		// 备份环境值
-		int oldlinecolor = getlinecolor();
-		int oldbkcolor = getbkcolor();
-		int oldfillcolor = getfillcolor();
-
-		setlinecolor(LIGHTGRAY);		// 设置画线颜色
-		setbkcolor(0xeeeeee);			// 设置背景颜色
-		setfillcolor(0xeeeeee);			// 设置填充颜色
-		fillrectangle(left, top, right, bottom);
-		
-		outtextxy(left + 10, top + 5,TCHAR(text));
-
-		// 恢复环境值
-		setlinecolor(oldlinecolor);
-		setbkcolor(oldbkcolor);
-		setfillcolor(oldfillcolor);
+		focused = false;
+		lead = 0;
 	}
 
-	void OnMessage()
+	void OnGUI() override
 	{
-		// 备份环境值
-		int oldlinecolor = getlinecolor();
-		int oldbkcolor = getbkcolor();
-		int oldfillcolor = getfillcolor();
-
-		setlinecolor(BLACK);			// 设置画线颜色
-		setbkcolor(WHITE);				// 设置背景颜色
-		setfillcolor(WHITE);			// 设置填充颜色
-		fillrectangle(left, top, right, bottom);
-		outtextxy(left + 10, top + 5, TCHAR(text));
-
-		int width = textwidth(TCHAR(text));	// 字符串总宽度
-		int counter = 0;				// 光标闪烁计数器
-		bool binput = true;				// 是否输入中
-
-		ExMessage msg;
-		while (binput)
+		setfillcolor(backColor);
+		setlinecolor(focused ? focusColor : edgeColor);
+		fillrectangle(rect.origin.x, rect.origin.y, rect.end.x, rect.end.y);
+		setbkmode(TRANSPARENT);
+		settextstyle(16, 0, fontName.c_str());
+		if (text.empty() && !focused)
+		{
+			settextcolor(hintColor);
+			drawtext(hint.c_str(), &rr, DT_VCENTER | DT_SINGLELINE);
+			return;
+		}
+		settextcolor(fontColor);
+		drawtext(text.c_str(), &rr, DT_VCENTER | DT_SINGLELINE);
+		if (!focused) return;
+		//光标半秒亮半秒灭，编辑后从亮开始
+		if ((canvas->Time() - editTime) / 500 % 2 != 0) return;
+		if (!measured)
+		{
+			caretX = textwidth(text.substr(0, caret).c_str());
+			measured = true;
+		}
+		int x = min(rr.left + caretX, rr.right);
+		setlinecolor(fontColor);
+		line(x, rect.origin.y + 4, x, rect.end.y - 4);
+	}
+	void OnEvent(ExMessage* message) override
+	{
+		switch (message->message)
 		{
-			while (binput && peekmessage(&msg, EX_MOUSE | EX_CHAR, false))	// 获取消息，但不从消息队列拿出
+		case WM_LBUTTONDOWN:
+			if (inRect(message->x, message->y, &rect))
 			{
-				if (msg.message == WM_LBUTTONDOWN)
-				{
-					// 如果鼠标点击文本框外面，结束文本输入
-					if (msg.x < left || msg.x > right || msg.y < top || msg.y > bottom)
-					{
-						binput = false;
-						break;
-					}
-				}
-				else if (msg.message == WM_CHAR)
-				{
-					size_t len = wcslen(text);
-					switch (msg.ch)
-					{
-					case '\b':				// 用户按退格键，删掉一个字符
-						if (len > 0)
-						{
-							text[len - 1] = 0;
-							width = textwidth(TCHAR(text));
-							counter = 0;
-							clearrectangle(left + 10 + width, top + 1, right - 1, bottom - 1);
-						}
-						break;
-					case '\r':				// 用户按回车键，结束文本输入
-					case '\n':
-						binput = false;
-						break;
-					default:				// 用户按其它键，接受文本输入
-						if (len < maxlen - 1)
-						{
-							text[len++] = msg.ch;
-							text[len] = 0;
-
-							clearrectangle(left + 10 + width + 1, top + 3, left + 10 + width + 1, bottom - 3);	// 清除画的光标
-							width = textwidth(TCHAR(text));				// 重新计算文本框宽度
-							counter = 0;
-							outtextxy(left + 10, top + 5, TCHAR(text));		// 输出新的字符串
-						}
-					}
-				}
-				peekmessage(NULL, EX_MOUSE | EX_CHAR);				// 从消息队列抛弃刚刚处理过的一个消息
+				if (!focused) Focus();
 			}
-
-			// 绘制光标（光标闪烁周期为 20ms * 32）
-			counter = (counter + 1) % 32;
-			if (counter < 16)
-				line(left + 10 + width + 1, top + 3, left + 10 + width + 1, bottom - 3);				// 画光标
-			else
-				clearrectangle(left + 10 + width + 1, top + 3, left + 10 + width + 1, bottom - 3);		// 擦光标
-
-			// 延时 20ms
-			Sleep(20);
+			else if (focused) Blur();
+			break;
+		case WM_CHAR:
+			if (focused) on_char(message->ch);
+			break;
+		case WM_KEYDOWN:
+			if (focused) on_key(message->vkcode);
+			break;
 		}
-
-		clearrectangle(left + 10 + width + 1, top + 3, left + 10 + width + 1, bottom - 3);	// 擦光标
-
-		// 恢复环境值
-		setlinecolor(oldlinecolor);
-		setbkcolor(oldbkcolor);
-		setfillcolor(oldfillcolor);
-
-		Show();
 	}
 };
-
-*/
-#pragma endregion
 #pragma endregion
\ No newline at end of file
@@ -0,0 +1,247 @@
+﻿#pragma once
+#include<vector>
+#include<memory>
+#include<algorithm>
+#include"framework.h"
+using namespace std;
+
+/// <summary>
+/// 布局节点。先Measure得到期望大小，再由父节点Arrange到具体矩形。
+/// 期望大小和上次的矩形都被缓存：内容变化时调用Invalidate，只有该节点到根的路径被标记为需要重新测量，
+/// 重新排列时矩形没有变化且没有被标记的子树直接跳过，改变画布大小或内容的代价与实际移动的部分成正比
+/// </summary>
+class Layout
+{
+	friend class LayoutPanel;
+	Layout* parent = nullptr;
+	bool dirty = true;  //子树需要重新排列
+	bool measured = false;  //desired是否有效
+	bool placed = false;  //是否排列过
+	Vector2 desired = { 0,0 };  //缓存的期望大小，x为宽，y为高
+	Rect bounds;  //上次排列的矩形
+protected:
+	//计算期望大小
+	virtual Vector2 measure() = 0;
+	//把自己和子节点排列到矩形内
+	virtual void arrange(Rect rect) = 0;
+public:
+	int grow = 0;  //父节点有剩余空间时按grow的比例分配，0表示不拉伸
+
+	//期望大小，未变化时直接返回缓存
+	Vector2 Measure()
+	{
+		if (!measured)
+		{
+			desired = measure();
+			measured = true;
+		}
+		return desired;
+	}
+	//排列到矩形内，矩形没有变化且未被标记时跳过整个子树
+	void Arrange(Rect rect)
+	{
+		if (placed && !dirty && rect.origin.x == bounds.origin.x && rect.origin.y == bounds.origin.y && rect.width == bounds.width && rect.height == bounds.height) return;
+		Measure();
+		bounds = rect;
+		arrange(rect);
+		dirty = false;
+		placed = true;
+	}
+	//内容或期望大小变化后调用，标记自己和全部祖先
+	void Invalidate()
+	{
+		//已标记的节点的祖先也都已标记
+		for (Layout* l = this; l != nullptr && (l->measured || !l->dirty); l = l->parent)
+		{
+			l->dirty = true;
+			l->measured = false;
+		}
+	}
+	//是否等待重新排列
+	bool Dirty() { return dirty; }
+	//上次排列的矩形
+	Rect Bounds() { return bounds; }
+	virtual ~Layout() {}
+};
+
+//叶子节点：把一个组件放到排列得到的矩形内，组件的内存不由布局管理
+class LayoutItem : public Layout
+{
+	GUIComponent* gui;
+	int width, height;  //期望大小
+protected:
+	Vector2 measure() override
+	{
+		return { width,height };
+	}
+	void arrange(Rect rect) override
+	{
+		if (gui != nullptr) gui->Arrange(rect);
+	}
+public:
+	//形参：组件，期望宽高
+	LayoutItem(GUIComponent* gui, int width, int height) : gui(gui), width(width), height(height) {}
+	//修改期望大小，只重新排列受影响的部分
+	void SetSize(int w, int h)
+	{
+		if (w == width && h == height) return;
+		width = w;
+		height = h;
+		Invalidate();
+	}
+	GUIComponent* Component() { return gui; }
+};
+
+//容器节点的公共部分：拥有子节点，子节点之间留spacing，四周留padding
+class LayoutPanel : public Layout
+{
+protected:
+	vector<unique_ptr<Layout>> children;
+
+	//容器内可用的矩形
+	Rect inner(Rect rect)
+	{
+		return createRectbyPoint(rect.origin.x + padding, rect.origin.y + padding, max(rect.origin.x + padding, rect.end.x - padding), max(rect.origin.y + padding, rect.end.y - padding));
+	}
+	//按grow分配剩余空间，返回每个子节点的额外长度
+	void share(int remain, vector<int>& extra)
+	{
+		extra.assign(children.size(), 0);
+		int total = 0;
+		for (auto& c : children) total += c->grow;
+		if (remain <= 0 || total == 0) return;
+		int given = 0, last = -1;
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			if (children[i]->grow == 0) continue;
+			extra[i] = remain * children[i]->grow / total;
+			given += extra[i];
+			last = (int)i;
+		}
+		//除不尽的部分给最后一个可拉伸的子节点
+		extra[last] += remain - given;
+	}
+	vector<int> extra;  //排列时复用
+public:
+	int spacing = 0;  //子节点间距
+	int padding = 0;  //四周留白
+
+	//添加子节点，返回它的引用便于继续设置
+	template<typename L>
+	L& Add(L* child)
+	{
+		child->parent = this;
+		children.emplace_back(child);
+		Invalidate();
+		return *child;
+	}
+	//添加组件，形参：组件，期望宽高，拉伸比例
+	LayoutItem& Add(GUIComponent* gui, int width, int height, int grow = 0)
+	{
+		LayoutItem& item = Add(new LayoutItem(gui, width, height));
+		item.grow = grow;
+		return item;
+	}
+	//移除并释放第i个子节点
+	void Remove(size_t i)
+	{
+		children.erase(children.begin() + i);
+		Invalidate();
+	}
+	size_t Size() { return children.size(); }
+	Layout& operator[](size_t i) { return *children[i]; }
+};
+
+//纵向堆叠：子节点从上到下排列，宽度撑满，高度为期望高度加上按grow分到的剩余高度
+class StackLayout : public LayoutPanel
+{
+protected:
+	Vector2 measure() override
+	{
+		Vector2 size = { 0,0 };
+		for (auto& c : children)
+		{
+			Vector2 d = c->Measure();
+			size.x = max(size.x, d.x);
+			size.y += d.y;
+		}
+		if (!children.empty()) size.y += spacing * ((int)children.size() - 1);
+		return { size.x + padding * 2,size.y + padding * 2 };
+	}
+	void arrange(Rect rect) override
+	{
+		Rect area = inner(rect);
+		share(area.height - (Measure().y - padding * 2), extra);
+		int y = area.origin.y;
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			int h = children[i]->Measure().y + extra[i];
+			children[i]->Arrange(createRectbyPoint(area.origin.x, y, area.end.x, y + h));
+			y += h + spacing;
+		}
+	}
+};
+
+//弹性横排：子节点从左到右排列，高度撑满，宽度为期望宽度加上按grow分到的剩余宽度
+class RowLayout : public LayoutPanel
+{
+protected:
+	Vector2 measure() override
+	{
+		Vector2 size = { 0,0 };
+		for (auto& c : children)
+		{
+			Vector2 d = c->Measure();
+			size.x += d.x;
+			size.y = max(size.y, d.y);
+		}
+		if (!children.empty()) size.x += spacing * ((int)children.size() - 1);
+		return { size.x + padding * 2,size.y + padding * 2 };
+	}
+	void arrange(Rect rect) override
+	{
+		Rect area = inner(rect);
+		share(area.width - (Measure().x - padding * 2), extra);
+		int x = area.origin.x;
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			int w = children[i]->Measure().x + extra[i];
+			children[i]->Arrange(createRectbyPoint(x, area.origin.y, x + w, area.end.y));
+			x += w + spacing;
+		}
+	}
+};
+
+//网格：子节点按行依次填入columns列，单元格大小相同，列宽均分可用宽度，行高为子节点中最大的期望高度
+class GridLayout : public LayoutPanel
+{
+	int columns;
+	int cellHeight = 0;  //measure时算出的行高
+protected:
+	Vector2 measure() override
+	{
+		Vector2 cell = { 0,0 };
+		for (auto& c : children)
+		{
+			Vector2 d = c->Measure();
+			cell.x = max(cell.x, d.x);
+			cell.y = max(cell.y, d.y);
+		}
+		cellHeight = cell.y;
+		int rows = ((int)children.size() + columns - 1) / columns;
+		return { cell.x * columns + spacing * (columns - 1) + padding * 2,cell.y * rows + spacing * max(rows - 1, 0) + padding * 2 };
+	}
+	void arrange(Rect rect) override
+	{
+		Rect area = inner(rect);
+		int cellWidth = max(0, (area.width - spacing * (columns - 1)) / columns);
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			int x = area.origin.x + (int)(i % columns) * (cellWidth + spacing);
+			int y = area.origin.y + (int)(i / columns) * (cellHeight + spacing);
+			children[i]->Arrange(createRectbyPoint(x, y, x + cellWidth, y + cellHeight));
+		}
+	}
+public:
+	GridLayout(int columns) : columns(max(columns, 1)) {}
+};
@@ -3,16 +3,160 @@
 #include<iostream>
 #include<vector>
 #include<cassert>
+#include<list>
+#include<unordered_map>
+#include<memory>
+#include<algorithm>
+#include<functional>
+#include<optional>
+#include<chrono>
 #include"framework.h"
+#include"thread_pool.h"
 #include<windows.h>
 using namespace std;
 
 
+/// <summary>
+/// 节点内存池：节点按块连续分配，释放的槽位用空闲链表复用，全部节点释放后归还内存。
+/// 只在画布线程上创建和删除节点
+/// </summary>
+class NodeArena
+{
+	static const size_t blockSlots = 4096;  //每块容纳的节点数
+	size_t slotSize = 0;  //槽位大小
+	vector<unique_ptr<char[]>> blocks;  //按地址排序
+	void* freeList = nullptr;  //空闲槽位链表，槽位的前几个字节保存下一个空闲槽位
+	size_t live = 0;  //已分配的节点数
+
+	//p是否位于某一块内
+	bool owns(void* p)
+	{
+		char* c = (char*)p;
+		auto i = upper_bound(blocks.begin(), blocks.end(), c, [](char* v, const unique_ptr<char[]>& b) {return v < b.get(); });
+		if (i == blocks.begin()) return false;
+		i--;
+		return c < i->get() + blockSlots * slotSize;
+	}
+	void add_block()
+	{
+		unique_ptr<char[]> block(new char[blockSlots * slotSize]);
+		char* base = block.get();
+		for (size_t i = blockSlots; i-- > 0;)
+		{
+			*(void**)(base + i * slotSize) = freeList;
+			freeList = base + i * slotSize;
+		}
+		auto at = upper_bound(blocks.begin(), blocks.end(), base, [](char* v, const unique_ptr<char[]>& b) {return v < b.get(); });
+		blocks.insert(at, std::move(block));
+	}
+public:
+	//形参：槽位大小
+	NodeArena(size_t size) : slotSize((size + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t)) {}
+	NodeArena(const NodeArena&) = delete;
+	NodeArena& operator=(const NodeArena&) = delete;
+
+	//分配size字节，超过槽位大小（Node的派生类）时使用全局分配
+	void* Allocate(size_t size)
+	{
+		if (size > slotSize) return ::operator new(size);
+		if (freeList == nullptr) add_block();
+		void* p = freeList;
+		freeList = *(void**)p;
+		live++;
+		return p;
+	}
+	void Free(void* p)
+	{
+		if (p == nullptr) return;
+		if (!owns(p))
+		{
+			::operator delete(p);
+			return;
+		}
+		*(void**)p = freeList;
+		freeList = p;
+		//全部节点都已释放，归还内存
+		if (--live == 0)
+		{
+			blocks.clear();
+			freeList = nullptr;
+		}
+	}
+	//已分配的节点数
+	size_t Live() { return live; }
+	//占用的块数
+	size_t Blocks() { return blocks.size(); }
+};
+
 class Menu;
+class NodeRegistry;
+class Node;
+
+//节点的异步进入钩子，结果按节点缓存
+class NodeEntry
+{
+public:
+	Node* owner = nullptr;  //所属节点，节点被删除后为nullptr，后台结果随之丢弃
+	bool loading = false;  //是否正在后台加载
+	bool hasValue = false;  //是否有缓存的结果
+	uint64_t generation = 0;  //每次加载或失效时递增，过期的加载结果被丢弃
+	int ttlMs = 0;  //缓存有效期，小于等于0表示一直有效直到Invalidate
+	chrono::steady_clock::time_point loadedAt;  //结果写入缓存的时间
+	string error;  //上次加载失败的原因
+
+	//缓存是否可以直接使用
+	bool Fresh()
+	{
+		return hasValue && (ttlMs <= 0 || chrono::steady_clock::now() - loadedAt < chrono::milliseconds(ttlMs));
+	}
+	//丢弃缓存和正在进行的加载，下次进入节点时重新加载
+	void Invalidate()
+	{
+		hasValue = false;
+		loading = false;
+		generation++;
+	}
+	//在加载线程上加载，完成后回到画布线程写入缓存
+	virtual void Start(Menu& menu, shared_ptr<NodeEntry> self) = 0;
+	//用缓存的结果更新界面，只在画布线程调用
+	virtual void Apply(Menu& menu) = 0;
+	virtual ~NodeEntry() {}
+};
+
+//节点的活动：进入节点时Start，离开节点或节点被删除时Stop，例如node_task.h中的协程
+class NodeActivity
+{
+public:
+	virtual void Start(Menu& menu) = 0;
+	//可以重复调用
+	virtual void Stop() = 0;
+	virtual ~NodeActivity() {}
+};
+
 class Node :public Object
 {
 private:
 	int lev = 0;//节点层级，根节点为0
+	NodeRegistry* registry = nullptr;  //所属菜单的索引，从父节点继承
+	string indexedTag;  //加入路径索引时的节点名
+	string key;  //用户指定的键
+
+	shared_ptr<NodeEntry> entry;  //异步进入钩子，可以为空
+	shared_ptr<NodeActivity> activity;  //节点活动，可以为空
+	//节点的序号，每个节点都不同。内存池会复用已释放节点的地址，以地址为键的缓存用它区分新旧节点
+	uint64_t serial = next_serial();
+
+	static uint64_t next_serial()
+	{
+		static uint64_t count = 0;
+		return ++count;
+	}
+	//加入所属菜单的索引
+	void attach();
+	//离开所属菜单的索引
+	void detach();
+	friend class NodeRegistry;
+	friend class Menu;
 public:
 	Node* parent = nullptr; //父节点指针，根节点为nullptr
 	void (*func)(Menu& munu, Canvas& canvas) = nullptr; //节点功能函数，循环执行
@@ -46,6 +190,8 @@ public:
 		lev = p->lev + 1;
 		onceFunc = once;
 		parent->childs.push_back(this);
+		registry = p->registry;
+		attach();
 	}
 	Node(Node* p, const char* t, void f(Menu& menu, Canvas& canvas) = nullptr,void once(Menu& menu)=nullptr)
 	{
@@ -61,17 +207,96 @@ public:
 		lev = p->lev + 1;
 		onceFunc = once;
 		parent->childs.push_back(this);
+		registry = p->registry;
+		attach();
 	}
 
 
-	//DFS析构
+	//析构整棵子树，用显式栈代替递归，极深的树也不会栈溢出
 	~Node()
 	{
-		if (childs.size() == 0) return;
-		for (auto i : childs) delete i;
+		vector<Node*> stack;
+		stack.swap(childs);
+		while (!stack.empty())
+		{
+			Node* node = stack.back();
+			stack.pop_back();
+			stack.insert(stack.end(), node->childs.begin(), node->childs.end());
+			//子节点的子树已转移到栈上，它的析构不会再递归
+			node->childs.clear();
+			delete node;
+		}
+		if (entry != nullptr) entry->owner = nullptr;
+		if (activity != nullptr) activity->Stop();
+		detach();
 	}
+
+	//节点从内存池分配，大量节点连续存放。内存池不随程序退出析构，全局菜单晚于它析构时仍可安全释放节点
+	static NodeArena& Arena()
+	{
+		static NodeArena* arena = new NodeArena(sizeof(Node));
+		return *arena;
+	}
+	static void* operator new(size_t size) { return Arena().Allocate(size); }
+	static void operator delete(void* p) { Arena().Free(p); }
 	
 #pragma endregion
+#pragma region 路径与键
+	//从根节点的子节点开始、以'/'连接的节点名路径，根节点为空串。节点名经过EscapeTag转义，可以直接交给FindByPath
+	string Path()
+	{
+		vector<Node*> chain;
+		for (Node* i = this; i->parent != nullptr; i = i->parent) chain.push_back(i);
+		string result;
+		for (size_t i = chain.size(); i-- > 0;)
+		{
+			result += EscapeTag(chain[i]->tag);
+			if (i > 0) result += '/';
+		}
+		return result;
+	}
+	//把节点名转义为路径中的一段：节点名中的'/'和'\'前加'\'，例如"输入/输出"写作"输入\/输出"
+	static string EscapeTag(const string& tag)
+	{
+		string result;
+		result.reserve(tag.size());
+		for (char c : tag)
+		{
+			if (c == '/' || c == '\\') result += '\\';
+			result += c;
+		}
+		return result;
+	}
+	//用户指定的键
+	const string& Key() { return key; }
+	//设置键，所属菜单可以通过键直接找到该节点，空串表示取消
+	void SetKey(const string& k);
+#pragma endregion
+#pragma region 异步进入
+	/// <summary>
+	/// 设置异步进入钩子：进入节点时load在加载线程ThreadPool::Loader()上执行，期间节点显示加载状态，完成后apply在画布线程上用结果更新界面。
+	/// 结果按节点缓存，再次进入时直接apply；ttlMs大于0时缓存超过该时长后重新加载
+	/// </summary>
+	template<typename R>
+	void SetAsyncEntry(function<R(void)> load, function<void(Menu& menu, R& result)> apply, int ttlMs = 0);
+	//设置节点活动，节点成为功能节点
+	void SetActivity(shared_ptr<NodeActivity> a)
+	{
+		if (activity != nullptr) activity->Stop();
+		activity = a;
+		funcNode = true;
+	}
+	//丢弃缓存的结果，下次进入时重新加载
+	void InvalidateEntry()
+	{
+		if (entry != nullptr) entry->Invalidate();
+	}
+	//是否正在后台加载
+	bool EntryLoading()
+	{
+		return entry != nullptr && entry->loading;
+	}
+#pragma endregion
 #pragma region 节点切换
 	//尝试跳转到下一节点
 	Node* Next(int id, bool* result=NULL)
@@ -99,14 +324,429 @@ public:
 #pragma endregion
 };
 
+//菜单内节点的路径索引和键索引，节点创建、删除、设置键时自动更新。
+//路径索引以(父节点, 节点名)为键，按路径查找时逐段命中，内存只与节点数有关，与树的深度无关，
+//修改节点名也只需要更新这一个节点，不需要更新整棵子树。查找的代价与路径的段数成正比
+class NodeRegistry
+{
+	struct ChildKey
+	{
+		Node* parent;
+		string tag;
+		bool operator==(const ChildKey& other) const { return parent == other.parent && tag == other.tag; }
+	};
+	struct ChildKeyHash
+	{
+		size_t operator()(const ChildKey& k) const { return hash<string>()(k.tag) ^ (hash<Node*>()(k.parent) * 31); }
+	};
+	Node* root = nullptr;
+	unordered_map<ChildKey, Node*, ChildKeyHash> byPath;
+	unordered_map<string, Node*> byKey;
+	friend class Node;
+
+	void add(Node* node)
+	{
+		if (node->parent == nullptr)
+		{
+			root = node;
+			return;
+		}
+		node->indexedTag = node->tag;
+		//同一父节点下有重名节点时，路径指向先创建的节点
+		byPath.insert({ { node->parent,node->indexedTag },node });
+		if (!node->key.empty()) byKey[node->key] = node;
+	}
+	//只使用节点自身保存的信息，父节点可能已被释放
+	void remove(Node* node)
+	{
+		if (node == root) root = nullptr;
+		auto i = byPath.find({ node->parent,node->indexedTag });
+		if (i != byPath.end() && i->second == node) byPath.erase(i);
+		auto k = byKey.find(node->key);
+		if (k != byKey.end() && k->second == node) byKey.erase(k);
+	}
+	void set_key(Node* node, const string& key)
+	{
+		auto k = byKey.find(node->key);
+		if (k != byKey.end() && k->second == node) byKey.erase(k);
+		node->key = key;
+		if (!key.empty()) byKey[key] = node;
+	}
+public:
+	//按路径查找，例如"课程信息录入/录入课程信息"，空串为根节点，不存在时返回nullptr。
+	//节点名中的'/'和'\'需要按Node::EscapeTag转义，Node::Path返回的路径已经转义
+	Node* FindByPath(const string& path)
+	{
+		Node* node = root;
+		ChildKey key;
+		size_t from = 0;
+		while (node != nullptr && from < path.size())
+		{
+			key.parent = node;
+			key.tag.clear();
+			size_t i = from;
+			for (; i < path.size() && path[i] != '/'; i++)
+			{
+				if (path[i] == '\\' && i + 1 < path.size()) i++;
+				key.tag += path[i];
+			}
+			auto found = byPath.find(key);
+			node = found == byPath.end() ? nullptr : found->second;
+			from = i + 1;
+		}
+		return node;
+	}
+	//按键查找，不存在时返回nullptr
+	Node* FindByKey(const string& key)
+	{
+		auto i = byKey.find(key);
+		return i == byKey.end() ? nullptr : i->second;
+	}
+	//节点名被修改后调用，子节点以父节点为键，不需要更新
+	void Reindex(Node* node)
+	{
+		remove(node);
+		add(node);
+	}
+	//已索引的节点数，不含根节点
+	size_t Size() { return byPath.size(); }
+};
+
+inline void Node::attach()
+{
+	if (registry != nullptr) registry->add(this);
+}
+inline void Node::detach()
+{
+	if (registry != nullptr) registry->remove(this);
+}
+inline void Node::SetKey(const string& k)
+{
+	if (registry != nullptr) registry->set_key(this, k);
+	else key = k;
+}
+
+/// <summary>
+/// 节点树的扁平索引：按层次遍历把节点排成数组，每个节点的子节点在数组中连续，
+/// 父节点和子节点都用下标表示，遍历不需要递归也不追随childs指针。树结构变化后需要重新Build。
+/// 节点本身仍由Node持有（从NodeArena连续分配），这里只是按需构建的只读视图，不是节点的存储
+/// </summary>
+class NodeTree
+{
+public:
+	struct Entry
+	{
+		Node* node;
+		int parent;  //父节点下标，根节点为-1
+		int firstChild;  //第一个子节点下标
+		int childCount;  //子节点数
+		int level;  //相对根节点的层级
+	};
+private:
+	vector<Entry> entries;
+public:
+	NodeTree() {}
+	NodeTree(Node* root) { Build(root); }
+	//以root为根重建索引
+	void Build(Node* root)
+	{
+		entries.clear();
+		if (root == nullptr) return;
+		entries.push_back({ root,-1,0,0,0 });
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			Node* node = entries[i].node;
+			entries[i].firstChild = (int)entries.size();
+			entries[i].childCount = (int)node->childs.size();
+			for (auto c : node->childs) entries.push_back({ c,(int)i,0,0,entries[i].level + 1 });
+		}
+	}
+	size_t Size() { return entries.size(); }
+	Entry& operator[](size_t i) { return entries[i]; }
+	//节点所在下标，不存在时返回-1，O(n)
+	int IndexOf(Node* node)
+	{
+		for (size_t i = 0; i < entries.size(); i++) if (entries[i].node == node) return (int)i;
+		return -1;
+	}
+	//按深度优先先序遍历，f(下标, Entry&)返回false时跳过该节点的子树
+	template<typename F>
+	void VisitDepthFirst(F f)
+	{
+		if (entries.empty()) return;
+		vector<int> stack{ 0 };
+		while (!stack.empty())
+		{
+			int i = stack.back();
+			stack.pop_back();
+			if (!f(i, entries[i])) continue;
+			for (int c = entries[i].firstChild + entries[i].childCount; c-- > entries[i].firstChild;) stack.push_back(c);
+		}
+	}
+};
+
 //节点菜单类，不负责具体逻辑，只负责维护节点树
 class Menu :public Object
 {
-	
+	//一个按钮槽位，滚动时只重新设置文字和对应的子节点
+	struct Slot
+	{
+		Button* button;
+		Text* text;  //按钮的文字，由按钮释放
+		Node* child;  //当前显示的子节点
+		int id;  //按钮的实例ID，创建时记下，按钮可能已被画布释放而不能再访问
+	};
+	class Scroller;
+	//一层菜单的按钮，进入该层时才创建。槽位数只取决于画布高度，子节点多于槽位时可以滚动
+	struct Level
+	{
+		vector<Slot> slots;
+		Scroller* scroller = nullptr;  //子节点多于槽位时才创建
+		int scrollerId = 0;  //滚动条的实例ID
+		int scroll = 0;  //第一个槽位显示的子节点下标
+		uint64_t serial = 0;  //创建该层时节点的序号，不同时说明原节点已删除、地址被新节点复用
+		list<Node*>::iterator lru;  //在最近访问表中的位置
+	};
+	//一层的滚动条，响应滚轮和方向键、翻页键
+	class Scroller : public GUIComponent
+	{
+		Menu* menu;
+		Node* node;
+		Level* level;  //unordered_map中的元素地址稳定
+		Rect area;  //响应滚轮的范围，即整列按钮
+		Rect bar;  //滚动条轨道
+		COLORREF color;
+	public:
+		Scroller(Menu* menu, Node* node, Level* level, Rect area, Rect bar, COLORREF color)
+			: menu(menu), node(node), level(level), area(area), bar(bar), color(color) {}
+		void OnGUI() override
+		{
+			int total = (int)node->childs.size();
+			int visible = (int)level->slots.size();
+			if (total <= visible) return;
+			int thumb = max(8, bar.height * visible / total);
+			int y = bar.origin.y + (bar.height - thumb) * level->scroll / (total - visible);
+			setlinecolor(color);
+			rectangle(bar.origin.x, bar.origin.y, bar.end.x, bar.end.y);
+			setfillcolor(color);
+			solidrectangle(bar.origin.x, y, bar.end.x, y + thumb);
+		}
+		void OnEvent(ExMessage* message) override
+		{
+			int visible = (int)level->slots.size();
+			if (message->message == WM_MOUSEWHEEL && inRect(message->x, message->y, &area))
+				menu->scroll_level(node, *level, message->wheel > 0 ? -1 : 1);
+			else if (message->message == WM_KEYDOWN)
+			{
+				if (message->vkcode == VK_UP) menu->scroll_level(node, *level, -1);
+				else if (message->vkcode == VK_DOWN) menu->scroll_level(node, *level, 1);
+				else if (message->vkcode == VK_PRIOR) menu->scroll_level(node, *level, -visible);
+				else if (message->vkcode == VK_NEXT) menu->scroll_level(node, *level, visible);
+			}
+		}
+	};
+	//按钮样式，由RegisterMenuByRootNode设置
+	struct Style
+	{
+		int xOffest, yOffest, yStep, width, height, edgeWidth;
+		COLORREF buttonColor, fontColor, lineColor;
+		string fontName;
+	};
+	bool registered = false;  //是否已设置按钮样式
+	Style style;
+	unordered_map<Node*, Level> levels;  //已创建按钮的层
+	list<Node*> recent;  //已创建按钮的层，最近访问的在前
+	size_t levelCapacity = 8;  //最多保留按钮的层数
 
-	Menu()
+	NodeRegistry registry;  //节点索引，root及其后代创建时自动加入
+	Text* loadingText = nullptr;  //异步进入钩子加载期间显示的文字
+	int loadingTextId = 0;  //加载文字的实例ID
+	shared_ptr<NodeActivity> running;  //当前节点正在进行的活动
+	vector<pair<int, int>> kept;  //当前节点每帧自动绘制的组件，(环境, id)
+
+	//画布高度内能放下的按钮数
+	int slot_count()
 	{
-		root = new Node();
+		if (style.yStep <= 0) return INT_MAX;
+		return max((canvas->Height() - style.height / 2 - style.yOffest) / style.yStep + 1, 1);
+	}
+	//第j个槽位的矩形
+	Rect slot_rect(int j)
+	{
+		Vector2 center = { canvas->Center().x + style.xOffest ,style.yStep * j + style.yOffest };
+		return createRectbyCenter(center, style.width, style.height);
+	}
+	//创建第j个槽位的按钮并注册，点击时进入该槽位当前显示的子节点
+	Slot create_slot(Node* node, int j)
+	{
+		Rect rect = slot_rect(j);
+		//创建GUI组件
+		Image* background = new Image(rect, style.buttonColor);
+		Text* text = new Text("", rect, style.fontName, style.fontColor);
+		LineBox* edge = new LineBox(rect, style.lineColor, style.edgeWidth);
+		Button* btn = new Button(background, text, edge);
+		//添加按钮监听回调
+		uint64_t serial = node->serial;
+		btn->AddListener([this, node, j, serial]()
+			{
+				auto found = levels.find(node);
+				if (found == levels.end() || found->second.serial != serial || j >= (int)found->second.slots.size()) return;
+				if (found->second.slots[j].child != nullptr) Enter(found->second.slots[j].child);
+			});
+		//注册
+		canvas->Env(0).Register(btn->InstanceId(), btn);
+		return { btn,text,nullptr,btn->InstanceId() };
+	}
+	//注销并释放一个组件，组件已被画布释放时只清理记录。
+	//id为创建时记下的实例ID，确认画布仍持有该组件之前不访问gui
+	template<typename G>
+	void release_component(G* gui, int id)
+	{
+		Canvas& env = canvas->Env(0);
+		if (env.ContainsKey(id) && env.GetGUI(id) == gui)
+		{
+			env.RemoveGUI(id);
+			delete gui;
+		}
+	}
+	//注销并释放一层的按钮，不访问节点（节点可能已被删除）
+	void release_level(Level& level)
+	{
+		for (auto& i : level.slots) release_component(i.button, i.id);
+		level.slots.clear();
+		if (level.scroller != nullptr) release_component(level.scroller, level.scrollerId);
+		level.scroller = nullptr;
+	}
+	//按画布高度创建槽位，子节点多于槽位时加上滚动条
+	void build_level(Node* node, Level& level)
+	{
+		int total = (int)node->childs.size();
+		int count = min(total, slot_count());
+		for (int j = 0; j < count; j++) level.slots.push_back(create_slot(node, j));
+		if (total > count)
+		{
+			Rect first = slot_rect(0), last = slot_rect(count - 1);
+			Rect bar = createRectbyPoint(first.end.x + 6, first.origin.y, first.end.x + 14, last.end.y);
+			Rect area = createRectbyPoint(first.origin.x, first.origin.y, bar.end.x, last.end.y);
+			level.scroller = new Scroller(this, node, &level, area, bar, style.lineColor);
+			level.scrollerId = level.scroller->InstanceId();
+			canvas->Env(0).Register(level.scrollerId, level.scroller);
+		}
+	}
+	//让槽位显示scroll开始的子节点，只检查可见的槽位，开销与子节点总数无关
+	void sync_level(Node* node, Level& level)
+	{
+		int total = (int)node->childs.size();
+		int count = min(total, slot_count());
+		//子节点数量跨过槽位数（例如增删子节点或画布变化）时重建
+		if (count != (int)level.slots.size() || (total > count) != (level.scroller != nullptr))
+		{
+			release_level(level);
+			build_level(node, level);
+		}
+		level.scroll = max(0, min(level.scroll, total - count));
+		for (int j = 0; j < count; j++)
+		{
+			Node* child = node->childs[level.scroll + j];
+			if (level.slots[j].child != child)
+			{
+				level.slots[j].child = child;
+				level.slots[j].text->SetText(child->tag);
+			}
+		}
+	}
+	//滚动一层，rows为正时向下
+	void scroll_level(Node* node, Level& level, int rows)
+	{
+		level.scroll += rows;
+		sync_level(node, level);
+	}
+	//确保一层的按钮已创建并与子节点一致，标记为最近访问，超出容量时释放最久未访问的层
+	void materialize(Node* node)
+	{
+		if (!registered || node->funcNode) return;
+		auto found = levels.find(node);
+		if (found == levels.end())
+		{
+			recent.push_front(node);
+			found = levels.insert({ node,Level() }).first;
+			found->second.lru = recent.begin();
+			found->second.serial = node->serial;
+		}
+		else
+		{
+			recent.splice(recent.begin(), recent, found->second.lru);
+			//原节点已删除，新节点复用了它的地址，旧层的按钮和滚动位置都不属于新节点
+			if (found->second.serial != node->serial)
+			{
+				release_level(found->second);
+				found->second.scroll = 0;
+				found->second.serial = node->serial;
+			}
+		}
+		sync_level(node, found->second);
+		//当前层和刚离开的层（可能正在分发点击消息）总在最近的两层内，不会被释放
+		while (recent.size() > levelCapacity)
+		{
+			Node* old = recent.back();
+			recent.pop_back();
+			release_level(levels[old]);
+			levels.erase(old);
+		}
+	}
+	//进入节点，创建该层按钮并调用节点更新辅助函数，有异步钩子时使用缓存或开始加载
+	void Enter(Node* node)
+	{
+		//结束上一个节点的活动和自动绘制
+		if (running != nullptr) running->Stop();
+		running = nullptr;
+		kept.clear();
+		current = node;
+		materialize(current);
+		if (current->onceFunc != nullptr) current->onceFunc(*this);
+		shared_ptr<NodeEntry> entry = current->entry;
+		if (entry != nullptr)
+		{
+			if (entry->Fresh()) entry->Apply(*this);
+			else if (!entry->loading) entry->Start(*this, entry);
+		}
+		if (current->activity != nullptr)
+		{
+			running = current->activity;
+			running->Start(*this);
+		}
+	}
+	//当前节点的异步钩子正在加载或加载失败时绘制提示，返回是否绘制了
+	bool draw_loading()
+	{
+		NodeEntry* entry = current->entry.get();
+		if (entry == nullptr || entry->hasValue || (!entry->loading && entry->error.empty())) return false;
+		if (loadingText == nullptr)
+		{
+			Rect rect = createRectbyCenter(canvas->Center(), canvas->Width(), 40);
+			loadingText = new Text("", rect, registered ? style.fontName : "宋体", registered ? style.fontColor : BLACK);
+			loadingTextId = loadingText->InstanceId();
+			canvas->Env(0).Register(loadingTextId, loadingText);
+		}
+		if (entry->loading) loadingText->SetText("加载中" + string(canvas->Time() / 300 % 3 + 1, '.'));
+		else loadingText->SetText("加载失败：" + entry->error);
+		canvas->Env(0).Draw(loadingTextId);
+		return true;
+	}
+	//从根节点沿路径逐层进入target，途经的每个节点都调用辅助函数，中间层不创建按钮
+	bool navigate(Node* target)
+	{
+		if (target == nullptr || target->registry != &registry) return false;
+		vector<Node*> chain;
+		for (Node* i = target; i != root; i = i->parent) chain.push_back(i);
+		//chain[0]为target，最后一个是根节点的子节点
+		for (size_t i = chain.size(); i-- > 1;)
+		{
+			current = chain[i];
+			if (current->onceFunc != nullptr) current->onceFunc(*this);
+		}
+		Enter(target);
+		return true;
 	}
 public:
 	Node* root;  //根节点
@@ -118,40 +758,89 @@ public:
 	Menu( Canvas* cv)
 	{
 		root = new Node();
+		root->registry = &registry;
+		root->attach();
 		canvas = cv;  //画布
 		current = root;  //当前节点
 
 	}
 	~Menu()
 	{
+		//释放仍保留的按钮
+		for (auto& i : levels) release_level(i.second);
+		if (loadingText != nullptr) release_component(loadingText, loadingTextId);
+		if (running != nullptr) running->Stop();
 		//在根节点DFS回收整个N叉树
 		delete root;
 	}
+	//设置最多保留按钮的层数，至少为2
+	void SetLevelCapacity(int capacity)
+	{
+		levelCapacity = max(capacity, 2);
+		if (registered) materialize(current);
+	}
 #pragma region 节点跳转函数
 
 	//节点函数，负责节点跳转，如果不允许跳转，则current不变，每次跳转都调用节点更新辅助函数
 	void ToRoot()
 	{
-		current = root;
-		if (current->onceFunc != nullptr) current->onceFunc(*this);
+		Enter(root);
 	}
 	//节点函数，负责节点跳转，如果不允许跳转，则current不变，每次跳转都调用节点更新辅助函数
 	void Last()
 	{
-		current = current->Last();
-		if (current->onceFunc != nullptr) current->onceFunc(*this);
+		Enter(current->Last());
 	}
 	//节点函数，负责节点跳转，如果不允许跳转，则current不变，每次跳转都调用节点更新辅助函数
 	void Next(int idx)
 	{
-		current = current->Next(idx);
-		if (current->onceFunc != nullptr) current->onceFunc(*this);
+		Enter(current->Next(idx));
+	}
+	//直接跳转到本菜单内的任意节点，从根节点起依次调用路径上各节点的辅助函数，节点不属于本菜单时返回false
+	bool NavigateTo(Node* node)
+	{
+		return navigate(node);
+	}
+	//按节点名路径跳转，例如"课程信息录入/录入课程信息"
+	bool NavigateToPath(const string& path)
+	{
+		return navigate(registry.FindByPath(path));
 	}
+	//按节点的键跳转，用于快捷键和恢复上次的界面
+	bool NavigateToKey(const string& key)
+	{
+		return navigate(registry.FindByKey(key));
+	}
+	//在当前节点停留期间每帧自动绘制已注册的组件，离开节点时取消，不需要每帧调用func
+	void Keep(int id, int env = 0)
+	{
+		kept.push_back({ env,id });
+	}
+	//取消当前节点的全部自动绘制
+	void ClearKept()
+	{
+		kept.clear();
+	}
+	//丢弃当前节点缓存的异步结果并重新加载
+	void Refresh()
+	{
+		current->InvalidateEntry();
+		Enter(current);
+	}
+	//滚动当前层，rows为正时向下
+	void Scroll(int rows)
+	{
+		if (!registered || current->funcNode) return;
+		materialize(current);
+		scroll_level(current, levels[current], rows);
+	}
+	//节点索引，节点名被修改后调用Nodes().Reindex(节点)
+	NodeRegistry& Nodes() { return registry; }
 
 	/// <summary>
-	/// 注册根节点组成的菜单
+	/// 设置根节点组成的菜单的按钮样式。按钮在进入某层时才创建，最近访问的若干层保留按钮，其余层的按钮被释放。
+	/// 每层的按钮数不超过画布高度能容纳的数量，子节点更多时用滚轮、方向键或翻页键滚动
 	/// </summary>
-	/// <param name="root">根节点</param>
 	/// <param name="xOffest">x偏移，在画布中心x的基础上偏移</param>
 	/// <param name="yOffest">y偏移，在画布最顶端的基础上向下偏移</param>
 	/// <param name="yStep">按钮生成的步长</param>
@@ -164,44 +853,40 @@ public:
 	/// <param name="fontName">字体名称</param>
 	void RegisterMenuByRootNode( int xOffest, int yOffest, int yStep, int width, int height,int edgeWidth, COLORREF buttonColor, COLORREF fontColor, COLORREF lineColor, string fontName)
 	{
-		//N叉树节点层次遍历，注册按钮
-		queue<Node*> que;
-		que.push(root);
-		while (!que.empty())
-		{
-			Node* node = que.front();
-			que.pop();
-			for (int i = 0; i < node->childs.size(); i++)
-			{
-				//计算Button位置和范围
-				Vector2 center = { canvas->Center().x+xOffest ,yStep * i + yOffest };
-				Rect rect = createRectbyCenter(center, width, height);
-				//创建GUI组件
-				Image* background = new Image(rect, buttonColor);
-				Text* text = new Text(node->childs[i]->tag.c_str(), rect, fontName, fontColor);
-				LineBox* edge = new LineBox(rect, lineColor, edgeWidth);
-				Button* btn = new Button(background, text,edge);
-				//添加按钮监听回调
-				btn->AddListener([i,this]() {Next(i + 1); });
-				//注册
-				canvas->Env(0).Register(node->childs[i]->InstanceId(), btn);
-				que.push(node->childs[i]);
-			}
-		}
+		for (auto& i : levels) release_level(i.second);
+		levels.clear();
+		recent.clear();
+		style = { xOffest,yOffest,yStep,width,height,edgeWidth,buttonColor,fontColor,lineColor,fontName };
+		registered = true;
+		materialize(current);
 	}
 
 	void DrawOnGUI()
 	{
+		//异步钩子还没有结果时只显示加载状态
+		if (draw_loading()) return;
 
 		//功能节点自行决定实现逻辑
 		if (this->current->funcNode)
 		{
+			//绘制保留组件后切回原环境，不影响func内的当前环境
+			int env = canvas->GetEnv();
+			for (auto& i : kept) canvas->Env(i.first).Draw(i.second);
+			canvas->Env(env);
 			if (this->current->func != nullptr) this->current->func(*this, *canvas);
 		}
 		//非功能节点按位置分布自动渲染,在Env0内进行操作
-		else for (int i = 0; i < (this->current)->childs.size(); i++)
+		else
 		{
-			canvas->Env(0).Draw(this->current->childs[i]->InstanceId());//渲染节点菜单GUI
+			materialize(current);
+			if (!registered) return;
+			//只绘制可见的槽位，子节点再多每帧开销也不变
+			Level& level = levels[current];
+			for (auto& i : level.slots)
+			{
+				canvas->Env(0).Draw(i.id);//渲染节点菜单GUI
+			}
+			if (level.scroller != nullptr) canvas->Env(0).Draw(level.scrollerId);
 		}
 	}
 
@@ -212,6 +897,73 @@ public:
 
 
 
+//返回类型为R的异步进入钩子
+template<typename R>
+class AsyncNodeEntry : public NodeEntry
+{
+	function<R(void)> load;
+	function<void(Menu&, R&)> apply;
+	optional<R> value;  //缓存的结果
+public:
+	AsyncNodeEntry(function<R(void)> load, function<void(Menu&, R&)> apply) : load(load), apply(apply) {}
+
+	void Start(Menu& menu, shared_ptr<NodeEntry> self) override
+	{
+		loading = true;
+		error.clear();
+		uint64_t gen = ++generation;
+		Menu* m = &menu;
+		//加载线程是静态的，可能在画布析构后才完成，只持有投递队列
+		shared_ptr<PostBox> box = menu.canvas->Mailbox();
+		shared_ptr<AsyncNodeEntry> me = static_pointer_cast<AsyncNodeEntry>(self);
+		ThreadPool::Loader().Submit([me, gen, m, box]()
+			{
+				shared_ptr<R> result;
+				string reason;
+				try
+				{
+					result = make_shared<R>(me->load());
+				}
+				catch (const exception& e)
+				{
+					reason = e.what();
+				}
+				catch (...)
+				{
+					reason = "未知错误";
+				}
+				box->Post([me, gen, m, result, reason]()
+					{
+						//节点已删除，或加载期间缓存被置为失效
+						if (me->owner == nullptr || me->generation != gen) return;
+						me->loading = false;
+						if (result == nullptr)
+						{
+							me->error = reason;
+							return;
+						}
+						me->value = std::move(*result);
+						me->hasValue = true;
+						me->loadedAt = chrono::steady_clock::now();
+						if (m->current == me->owner) me->Apply(*m);
+					});
+			});
+	}
+	void Apply(Menu& menu) override
+	{
+		if (value.has_value() && apply) apply(menu, *value);
+	}
+};
+
+template<typename R>
+void Node::SetAsyncEntry(function<R(void)> load, function<void(Menu& menu, R& result)> apply, int ttlMs)
+{
+	if (entry != nullptr) entry->owner = nullptr;
+	entry = make_shared<AsyncNodeEntry<R>>(load, apply);
+	entry->owner = this;
+	entry->ttlMs = ttlMs;
+}
+
 inline void last_menu(Menu& menu,Canvas& canvas)
 {
 	menu.Last();
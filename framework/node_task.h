@@ -0,0 +1,264 @@
+﻿#pragma once
+//协程节点，需要C++20（VisualStudio中设置 /std:c++latest 或 /std:c++20），低版本下本文件为空
+#if defined(__cpp_impl_coroutine)
+#include<coroutine>
+#include<exception>
+#include<memory>
+#include<optional>
+#include<type_traits>
+#include"node_menu.h"
+#include"thread_pool.h"
+using namespace std;
+
+/// <summary>
+/// 节点协程的返回类型。节点函数写成协程后可以跨帧等待，不需要手写状态机：
+/// NodeTask select(Menu& menu, Canvas& canvas)
+/// {
+///		menu.Keep(ok->InstanceId());
+///		co_await Clicked(ok);
+///		vector<Course> rows = co_await Background(canvas, [] {return load_courses(); });
+///		co_await Delay(canvas, 1000);
+///		menu.Last();
+/// }
+/// 等待期间协程不占用任何帧时间，只有等待的事件发生时才被恢复。离开节点时协程被销毁，未完成的等待随之取消
+/// </summary>
+class NodeTask
+{
+public:
+	struct promise_type
+	{
+		shared_ptr<bool> alive = make_shared<bool>(true);  //协程被销毁后为false，迟到的事件据此丢弃
+		bool executing = false;  //是否正在执行，执行期间被放弃时推迟到挂起后销毁
+		exception_ptr error;
+
+		NodeTask get_return_object() { return NodeTask(coroutine_handle<promise_type>::from_promise(*this)); }
+		suspend_always initial_suspend() { return {}; }
+		suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { error = current_exception(); }
+	};
+	typedef coroutine_handle<promise_type> Handle;
+
+	//恢复协程，协程在执行期间被放弃时在这里销毁，协程抛出的异常在这里重新抛出
+	static void Resume(Handle h, const shared_ptr<bool>& alive)
+	{
+		if (!*alive || h.done()) return;
+		shared_ptr<bool> hold = alive;
+		h.promise().executing = true;
+		h.resume();
+		if (!*hold)
+		{
+			h.destroy();
+			return;
+		}
+		h.promise().executing = false;
+		if (h.promise().error) rethrow_exception(exchange(h.promise().error, nullptr));
+	}
+private:
+	Handle handle;
+public:
+	NodeTask() {}
+	explicit NodeTask(Handle h) : handle(h) {}
+	NodeTask(NodeTask&& other) noexcept : handle(exchange(other.handle, nullptr)) {}
+	NodeTask& operator=(NodeTask&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			handle = exchange(other.handle, nullptr);
+		}
+		return *this;
+	}
+	NodeTask(const NodeTask&) = delete;
+	~NodeTask()
+	{
+		release();
+	}
+	//开始执行，直到第一次等待
+	void Start()
+	{
+		if (handle) Resume(handle, handle.promise().alive);
+	}
+	bool Done() { return !handle || handle.done(); }
+private:
+	//放弃协程，正在执行时由Resume在挂起后销毁
+	void release()
+	{
+		if (!handle) return;
+		*handle.promise().alive = false;
+		if (!handle.promise().executing) handle.destroy();
+		handle = nullptr;
+	}
+};
+
+#pragma region 等待对象
+//所有等待对象的公共部分：记录协程以便事件发生时恢复
+struct NodeAwaiter
+{
+	NodeTask::Handle handle;
+	shared_ptr<bool> alive;
+
+	bool await_ready() { return false; }
+	void suspend(coroutine_handle<NodeTask::promise_type> h)
+	{
+		handle = h;
+		alive = h.promise().alive;
+	}
+	//返回恢复协程的函数，协程被销毁后调用无效果
+	function<void(void)> resumer()
+	{
+		return [h = handle, alive = alive]() {NodeTask::Resume(h, alive); };
+	}
+	void await_resume() {}
+};
+
+//等待下一帧
+struct NextFrame : NodeAwaiter
+{
+	Canvas& canvas;
+	NextFrame(Canvas& canvas) : canvas(canvas) {}
+	void await_suspend(NodeTask::Handle h)
+	{
+		suspend(h);
+		canvas.Post(resumer());
+	}
+};
+
+//等待ms毫秒，按帧时间计时
+struct Delay : NodeAwaiter
+{
+	Canvas& canvas;
+	int ms;
+	int timer = -1;
+	Delay(Canvas& canvas, int ms) : canvas(canvas), ms(ms) {}
+	~Delay()
+	{
+		//协程在等待期间被销毁时取消定时器
+		if (timer >= 0 && !*alive) canvas.ClearTimeout(timer);
+	}
+	void await_suspend(NodeTask::Handle h)
+	{
+		suspend(h);
+		timer = canvas.SetTimeout(ms, resumer());
+	}
+};
+
+//等待按钮被点击
+struct Clicked : NodeAwaiter
+{
+	Button* button;
+	Connection connection;
+	Clicked(Button* button) : button(button) {}
+	~Clicked()
+	{
+		connection.Disconnect();
+	}
+	void await_suspend(NodeTask::Handle h)
+	{
+		suspend(h);
+		connection = button->onClick.Connect([this]()
+			{
+				connection.Disconnect();
+				//恢复后协程可能继续执行并销毁本对象，之后不能再访问成员
+				NodeTask::Resume(handle, alive);
+			});
+	}
+};
+
+//等待输入框按下回车，返回输入的内容
+struct Submitted : NodeAwaiter
+{
+	TextBox* box;
+	Connection connection;
+	Submitted(TextBox* box) : box(box) {}
+	~Submitted()
+	{
+		connection.Disconnect();
+	}
+	void await_suspend(NodeTask::Handle h)
+	{
+		suspend(h);
+		connection = box->onSubmit.Connect([this]()
+			{
+				connection.Disconnect();
+				NodeTask::Resume(handle, alive);
+			});
+	}
+	string await_resume() { return box->GetText(); }
+};
+
+//在加载线程ThreadPool::Loader()上执行f，完成后在画布线程恢复协程并返回f的结果，f抛出的异常在co_await处重新抛出
+template<typename F>
+struct BackgroundJob : NodeAwaiter
+{
+	typedef invoke_result_t<F> R;
+	typedef conditional_t<is_void_v<R>, bool, R> Stored;
+	//后台线程写入、画布线程读取的结果，协程被销毁后仍由后台任务持有
+	struct Slot
+	{
+		optional<Stored> value;
+		exception_ptr error;
+	};
+	Canvas& canvas;
+	F f;
+	shared_ptr<Slot> slot = make_shared<Slot>();
+
+	BackgroundJob(Canvas& canvas, F f) : canvas(canvas), f(std::move(f)) {}
+	void await_suspend(NodeTask::Handle h)
+	{
+		suspend(h);
+		ThreadPool::Loader().Submit([job = std::move(f), slot = slot, canvas = &canvas, resume = resumer()]() mutable
+			{
+				try
+				{
+					if constexpr (is_void_v<R>)
+					{
+						job();
+						slot->value = true;
+					}
+					else slot->value = job();
+				}
+				catch (...)
+				{
+					slot->error = current_exception();
+				}
+				canvas->Post(resume);
+			});
+	}
+	R await_resume()
+	{
+		if (slot->error) rethrow_exception(slot->error);
+		if constexpr (!is_void_v<R>) return std::move(*slot->value);
+	}
+};
+template<typename F>
+BackgroundJob<F> Background(Canvas& canvas, F f)
+{
+	return BackgroundJob<F>(canvas, std::move(f));
+}
+#pragma endregion
+
+//以协程作为节点活动：进入节点时启动，离开节点时销毁
+class TaskActivity : public NodeActivity
+{
+	function<NodeTask(Menu&, Canvas&)> body;
+	NodeTask task;
+public:
+	TaskActivity(function<NodeTask(Menu&, Canvas&)> body) : body(body) {}
+	void Start(Menu& menu) override
+	{
+		task = body(menu, *menu.canvas);
+		task.Start();
+	}
+	void Stop() override
+	{
+		task = NodeTask();
+	}
+};
+
+//把节点设为协程节点，形参：节点，协程函数
+inline void SetTask(Node* node, function<NodeTask(Menu&, Canvas&)> body)
+{
+	node->SetActivity(make_shared<TaskActivity>(body));
+}
+#endif
@@ -0,0 +1,102 @@
+﻿#pragma once
+#include<vector>
+#include<utility>
+#include<algorithm>
+#include"event_signal.h"
+using namespace std;
+
+/// <summary>
+/// 可观察的列表：每次修改后发出对应的信号，绑定的控件据此只更新受影响的行。
+/// 提供Size()和At(i)，可以直接交给GirdList::Bind；直接修改At返回的元素后需要调用Update(i)通知
+/// </summary>
+template<typename T>
+class ObservableList
+{
+	vector<T> items;
+public:
+	Signal<size_t, size_t> onInsert;  //(起始下标, 数量)，在插入之后发出
+	Signal<size_t, size_t> onErase;  //(起始下标, 数量)，在删除之后发出
+	Signal<size_t> onUpdate;  //(下标)，元素被替换或修改
+	Signal<size_t, size_t> onMove;  //(原下标, 新下标)，在移动之后发出
+	Signal<> onReset;  //整个列表被替换或清空
+
+	ObservableList() {}
+	ObservableList(vector<T> items) : items(std::move(items)) {}
+	ObservableList(const ObservableList&) = delete;
+	ObservableList& operator=(const ObservableList&) = delete;
+
+#pragma region 读取
+	size_t Size() { return items.size(); }
+	bool Empty() { return items.empty(); }
+	T* At(size_t i) { return &items[i]; }
+	const T& operator[](size_t i) const { return items[i]; }
+	typename vector<T>::const_iterator begin() const { return items.begin(); }
+	typename vector<T>::const_iterator end() const { return items.end(); }
+#pragma endregion
+
+#pragma region 修改
+	void Insert(size_t i, T value)
+	{
+		items.insert(items.begin() + i, std::move(value));
+		onInsert.Emit(i, 1);
+	}
+	void PushBack(T value)
+	{
+		items.push_back(std::move(value));
+		onInsert.Emit(items.size() - 1, 1);
+	}
+	//批量追加，只发出一次通知
+	template<typename It>
+	void Append(It first, It last)
+	{
+		size_t from = items.size();
+		items.insert(items.end(), first, last);
+		if (items.size() > from) onInsert.Emit(from, items.size() - from);
+	}
+	//删除从i开始的count个元素
+	void Erase(size_t i, size_t count = 1)
+	{
+		if (i >= items.size() || count == 0) return;
+		count = min(count, items.size() - i);
+		items.erase(items.begin() + i, items.begin() + i + count);
+		onErase.Emit(i, count);
+	}
+	//替换第i个元素
+	void Set(size_t i, T value)
+	{
+		items[i] = std::move(value);
+		onUpdate.Emit(i);
+	}
+	//就地修改第i个元素，f(T&)
+	template<typename F>
+	void Modify(size_t i, F f)
+	{
+		f(items[i]);
+		onUpdate.Emit(i);
+	}
+	//通知第i个元素已经通过At修改
+	void Update(size_t i)
+	{
+		onUpdate.Emit(i);
+	}
+	//把第from个元素移动到第to个位置，其间的元素依次前移或后移
+	void Move(size_t from, size_t to)
+	{
+		if (from == to || from >= items.size() || to >= items.size()) return;
+		if (from < to) rotate(items.begin() + from, items.begin() + from + 1, items.begin() + to + 1);
+		else rotate(items.begin() + to, items.begin() + from, items.begin() + from + 1);
+		onMove.Emit(from, to);
+	}
+	//替换全部元素
+	void Assign(vector<T> values)
+	{
+		items = std::move(values);
+		onReset.Emit();
+	}
+	void Clear()
+	{
+		items.clear();
+		onReset.Emit();
+	}
+#pragma endregion
+};
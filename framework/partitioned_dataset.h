@@ -0,0 +1,273 @@
+﻿#pragma once
+#include<string>
+#include<vector>
+#include<list>
+#include<map>
+#include<memory>
+#include<functional>
+#include<filesystem>
+#include"csvfile.h"
+#include"record_store.h"
+#include"schema.h"
+using namespace std;
+
+/// <summary>
+/// 按键分区的数据集：记录按分区键（例如学期、院系）分散在目录下的多个csv中，目录内的manifest.csv记录各分区的信息。
+/// 分区在第一次被访问时才加载，已加载分区的总大小超过预算时按最近最少使用淘汰，淘汰前保存修改。
+/// Partition返回的引用在加载其他分区后可能因淘汰而失效，需要长期持有时先Pin
+/// </summary>
+template<typename T>
+class PartitionedDataset
+{
+	struct Part
+	{
+		string key;  //分区键
+		string file;  //分区文件名，相对目录
+		size_t count = 0;  //记录数
+		uintmax_t bytes = 0;  //文件大小加上未保存的新增记录，作为内存占用的估计
+		unique_ptr<RecordStore<T>> store;  //已加载时不为空
+		bool dirty = false;  //是否有未保存的修改
+		bool listed = false;  //是否已写入磁盘上的清单
+		int pins = 0;  //固定计数，大于0时不会被淘汰
+		list<string>::iterator lru;  //在最近使用表中的位置
+	};
+	string dir;
+	function<string(const T&)> partitionOf;  //记录所在的分区键
+	uintmax_t budget;  //已加载分区的大小预算
+	uintmax_t loaded = 0;  //已加载分区的大小合计
+	map<string, Part> parts;
+	list<string> recent;  //已加载分区，最近使用的在前
+	int nextFile = 0;  //新分区文件编号
+	string buffer;  //写入清单时复用
+
+	string manifest_path() { return dir + "/manifest.csv"; }
+	string file_path(Part& p) { return dir + "/" + p.file; }
+
+	//读取清单：分区键,文件名,记录数,字节数
+	void load_manifest()
+	{
+		ifstream fin(manifest_path(), ios::binary);
+		string line;
+		while (getline(fin, line))
+		{
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			CsvCursor cursor(line);
+			string_view key, file, count, bytes;
+			if (!cursor.Next(key) || !cursor.Next(file) || !cursor.Next(count) || !cursor.Next(bytes)) continue;
+			Part& p = parts[string(key)];
+			p.key = string(key);
+			p.file = string(file);
+			SchemaCodec::Parse(count, p.count);
+			SchemaCodec::Parse(bytes, p.bytes);
+			p.listed = true;
+			int number = 0;
+			if (sscanf(p.file.c_str(), "part_%d.csv", &number) == 1 && number >= nextFile) nextFile = number + 1;
+		}
+	}
+	//写入清单
+	bool save_manifest()
+	{
+		AtomicFileWriter fout(manifest_path(), buffer);
+		if (!fout.Open()) return false;
+		for (auto& i : parts)
+		{
+			Part& p = i.second;
+			SchemaCodec::AppendCsv(buffer, p.key);
+			buffer += ',';
+			SchemaCodec::AppendCsv(buffer, p.file);
+			buffer += ',';
+			SchemaCodec::Append(buffer, p.count);
+			buffer += ',';
+			SchemaCodec::Append(buffer, p.bytes);
+			buffer += '\n';
+		}
+		if (!fout.Commit()) return false;
+		for (auto& i : parts) i.second.listed = true;
+		return true;
+	}
+	//保存分区
+	bool save_part(Part& p)
+	{
+		if (!p.dirty || p.store == nullptr) return true;
+		vector<T*> rows;
+		rows.reserve(p.store->Size());
+		p.store->ForEach([&rows](RecordHandle, T& t) {rows.push_back(&t); });
+		csvfile<T> file(file_path(p));
+		if (!file.write(rows)) return false;
+		error_code ec;
+		uintmax_t size = filesystem::file_size(file_path(p), ec);
+		loaded = loaded - p.bytes + (ec ? 0 : size);
+		p.bytes = ec ? 0 : size;
+		p.count = rows.size();
+		p.dirty = false;
+		//新分区文件第一次落盘时立即写入清单，否则崩溃后按清单计算的nextFile会重用这个文件名
+		if (!p.listed) return save_manifest();
+		return true;
+	}
+	//卸载分区，保存失败时保留在内存中
+	bool unload(Part& p)
+	{
+		if (!save_part(p)) return false;
+		p.store.reset();
+		recent.erase(p.lru);
+		loaded -= p.bytes;
+		return true;
+	}
+	//超出预算时从最久未使用的分区开始淘汰，keep为刚访问、不能淘汰的分区
+	void evict(const string& keep)
+	{
+		vector<string> victims;
+		uintmax_t remain = loaded;
+		for (auto i = recent.rbegin(); i != recent.rend() && remain > budget; i++)
+		{
+			Part& p = parts[*i];
+			if (p.key == keep || p.pins > 0) continue;
+			victims.push_back(*i);
+			remain -= p.bytes;
+		}
+		for (auto& key : victims) unload(parts[key]);
+	}
+	//确保分区已加载并标记为最近使用
+	Part& touch(const string& key)
+	{
+		Part& p = parts[key];
+		if (p.store == nullptr)
+		{
+			if (p.file.empty())
+			{
+				p.key = key;
+				//跳过磁盘上已存在但清单中没有记录的文件
+				error_code ec;
+				do p.file = "part_" + to_string(nextFile++) + ".csv";
+				while (filesystem::exists(file_path(p), ec));
+			}
+			//读取失败时抛出异常，分区保持未加载的状态
+			unique_ptr<RecordStore<T>> store(new RecordStore<T>());
+			csvfile<T>(file_path(p)).read_into(*store);
+			p.store = std::move(store);
+			p.count = p.store->Size();
+			error_code ec;
+			uintmax_t size = filesystem::file_size(file_path(p), ec);
+			p.bytes = ec ? 0 : size;
+			loaded += p.bytes;
+			recent.push_front(key);
+			p.lru = recent.begin();
+			evict(key);
+		}
+		else if (p.lru != recent.begin())
+		{
+			recent.splice(recent.begin(), recent, p.lru);
+		}
+		return p;
+	}
+public:
+	/// <summary>
+	/// 形参：数据目录，取分区键函数，已加载分区的大小预算（字节）
+	/// </summary>
+	PartitionedDataset(const string& dir, function<string(const T&)> partitionOf, uintmax_t budget = 256 * 1024 * 1024)
+		: dir(dir), partitionOf(partitionOf), budget(budget)
+	{
+		checkAndCreatePathAndFile(manifest_path());
+		load_manifest();
+	}
+	//保存所有修改
+	~PartitionedDataset()
+	{
+		Save();
+	}
+	PartitionedDataset(const PartitionedDataset&) = delete;
+	PartitionedDataset& operator=(const PartitionedDataset&) = delete;
+
+#pragma region 分区访问
+	//全部分区键，不加载任何分区
+	vector<string> Keys()
+	{
+		vector<string> keys;
+		for (auto& i : parts) keys.push_back(i.first);
+		return keys;
+	}
+	//分区内的记录数，不加载分区
+	size_t Count(const string& key)
+	{
+		auto i = parts.find(key);
+		if (i == parts.end()) return 0;
+		return i->second.store != nullptr ? i->second.store->Size() : i->second.count;
+	}
+	//分区是否已在内存中
+	bool Loaded(const string& key)
+	{
+		auto i = parts.find(key);
+		return i != parts.end() && i->second.store != nullptr;
+	}
+	//获取分区的记录容器，未加载时先加载，分区不存在时创建空分区
+	RecordStore<T>& Partition(const string& key)
+	{
+		return *touch(key).store;
+	}
+	//固定分区使其不被淘汰，与Unpin成对调用
+	RecordStore<T>& Pin(const string& key)
+	{
+		Part& p = touch(key);
+		p.pins++;
+		return *p.store;
+	}
+	//不存在的分区忽略
+	void Unpin(const string& key)
+	{
+		auto i = parts.find(key);
+		if (i == parts.end()) return;
+		if (i->second.pins > 0) i->second.pins--;
+		evict("");
+	}
+	//逐个分区遍历全部记录，f(分区键, RecordHandle, T&)。
+	//正在遍历的分区被固定，f向其他分区插入记录引起的淘汰不会卸载它；遍历开始后新建的分区不会被遍历
+	template<typename F>
+	void ForEach(F f)
+	{
+		for (auto& key : Keys())
+		{
+			RecordStore<T>& store = Pin(key);
+			try
+			{
+				store.ForEach([&](RecordHandle h, T& t) {f(key, h, t); });
+			}
+			catch (...)
+			{
+				Unpin(key);
+				throw;
+			}
+			Unpin(key);
+		}
+	}
+#pragma endregion
+
+#pragma region 修改
+	//插入记录到其所在分区
+	RecordHandle Insert(const T& value)
+	{
+		string key = partitionOf(value);
+		Part& p = touch(key);
+		RecordHandle h = p.store->Insert(value);
+		if (!h.Valid()) return h;
+		p.dirty = true;
+		//保存前按记录大小估计增长，保存后以文件大小为准
+		p.bytes += sizeof(T);
+		loaded += sizeof(T);
+		evict(key);
+		return h;
+	}
+	//通过Partition直接修改记录后调用，保存或淘汰时写回
+	void MarkDirty(const string& key)
+	{
+		auto i = parts.find(key);
+		if (i != parts.end() && i->second.store != nullptr) i->second.dirty = true;
+	}
+	//保存所有已修改的分区和清单
+	bool Save()
+	{
+		bool ok = true;
+		for (auto& i : parts) ok = save_part(i.second) && ok;
+		return save_manifest() && ok;
+	}
+#pragma endregion
+};
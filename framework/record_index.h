@@ -0,0 +1,175 @@
+﻿#pragma once
+#include<vector>
+#include<functional>
+#include<utility>
+#include"record_store.h"
+using namespace std;
+
+/// <summary>
+/// 记录容器上的哈希索引，开放寻址（线性探测），删除时回移后续元素而不留墓碑，查找过程不分配内存。
+/// 构造时挂接到容器并索引已有记录，之后随容器的插入、修改、删除自动更新，析构时解除挂接
+/// </summary>
+/// <typeparam name="T">记录类型</typeparam>
+/// <typeparam name="K">键类型</typeparam>
+template<typename T, typename K, typename Hash = hash<K>>
+class HashIndex : public IRecordIndex<T>
+{
+	struct Entry
+	{
+		K key;
+		RecordHandle handle;
+		size_t hash = 0;
+		bool used = false;
+	};
+	RecordStore<T>& store;  //被索引的容器
+	function<K(const T&)> extract;  //从记录中取出键
+	bool unique;  //是否为唯一索引
+	vector<Entry> table;  //容量始终为2的幂
+	size_t count = 0;  //已用槽位
+	Hash hasher;
+
+	size_t mask() { return table.size() - 1; }
+
+	//装载率超过0.7时扩容
+	void grow()
+	{
+		if (table.size() != 0 && (count + 1) * 10 <= table.size() * 7) return;
+		vector<Entry> old = std::move(table);
+		table = vector<Entry>(old.empty() ? 16 : old.size() * 2);
+		count = 0;
+		for (auto& i : old) if (i.used) place(std::move(i.key), i.handle, i.hash);
+	}
+	//不检查容量直接放入
+	void place(K&& key, RecordHandle h, size_t hv)
+	{
+		size_t i = hv & mask();
+		while (table[i].used) i = (i + 1) & mask();
+		table[i].key = std::move(key);
+		table[i].handle = h;
+		table[i].hash = hv;
+		table[i].used = true;
+		count++;
+	}
+	//删除槽位i，并把后续探测链上的元素回移填补空位
+	void remove_at(size_t i)
+	{
+		size_t j = i;
+		while (true)
+		{
+			j = (j + 1) & mask();
+			if (!table[j].used) break;
+			size_t home = table[j].hash & mask();
+			//home落在(i,j]之间的元素不需要移动
+			bool stay = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+			if (stay) continue;
+			table[i] = std::move(table[j]);
+			i = j;
+		}
+		table[i].used = false;
+		table[i].key = K();
+		count--;
+	}
+	//查找键为key、句柄不为except的第一个槽位，没有则返回-1
+	long long probe(const K& key, size_t hv, RecordHandle except)
+	{
+		if (table.empty()) return -1;
+		size_t i = hv & mask();
+		while (table[i].used)
+		{
+			if (table[i].hash == hv && table[i].handle != except && table[i].key == key) return (long long)i;
+			i = (i + 1) & mask();
+		}
+		return -1;
+	}
+public:
+	//形参：被索引的容器，取键函数，是否唯一
+	HashIndex(RecordStore<T>& store, function<K(const T&)> extract, bool unique = false)
+		: store(store), extract(extract), unique(unique)
+	{
+		store.Attach(this);
+	}
+	~HashIndex()
+	{
+		store.Detach(this);
+	}
+	HashIndex(const HashIndex&) = delete;
+	HashIndex& operator=(const HashIndex&) = delete;
+
+#pragma region 查询
+	//按键查找句柄，非唯一索引返回任意一条，没有则返回无效句柄
+	RecordHandle Find(const K& key)
+	{
+		long long i = probe(key, hasher(key), RecordHandle{});
+		return i < 0 ? RecordHandle{} : table[(size_t)i].handle;
+	}
+	//按键查找记录，没有则返回nullptr
+	T* Get(const K& key)
+	{
+		return store.Get(Find(key));
+	}
+	//遍历键为key的全部记录，f(RecordHandle, T&)
+	template<typename F>
+	void FindAll(const K& key, F f)
+	{
+		if (table.empty()) return;
+		size_t hv = hasher(key);
+		size_t i = hv & mask();
+		while (table[i].used)
+		{
+			if (table[i].hash == hv && table[i].key == key) f(table[i].handle, *store.Get(table[i].handle));
+			i = (i + 1) & mask();
+		}
+	}
+	//键为key的记录数
+	size_t Count(const K& key)
+	{
+		size_t n = 0;
+		FindAll(key, [&n](RecordHandle, T&) {n++; });
+		return n;
+	}
+	//是否包含键
+	bool Contains(const K& key) { return Find(key).Valid(); }
+#pragma endregion
+
+#pragma region 容器通知
+	bool CanInsert(const T& value, RecordHandle self) override
+	{
+		if (!unique) return true;
+		K key = extract(value);
+		//self为无效句柄时不会与任何槽位相等，等价于检查全部
+		return probe(key, hasher(key), self) < 0;
+	}
+	void OnInsert(RecordHandle h, const T& value) override
+	{
+		grow();
+		K key = extract(value);
+		size_t hv = hasher(key);
+		place(std::move(key), h, hv);
+	}
+	void OnErase(RecordHandle h, const T& value) override
+	{
+		if (table.empty()) return;
+		K key = extract(value);
+		size_t hv = hasher(key);
+		size_t i = hv & mask();
+		while (table[i].used)
+		{
+			if (table[i].handle == h)
+			{
+				remove_at(i);
+				return;
+			}
+			i = (i + 1) & mask();
+		}
+	}
+	void OnClear() override
+	{
+		for (auto& i : table)
+		{
+			i.used = false;
+			i.key = K();
+		}
+		count = 0;
+	}
+#pragma endregion
+};
@@ -0,0 +1,269 @@
+﻿#pragma once
+#include<vector>
+#include<memory>
+#include<bitset>
+#include<cstdint>
+#include<functional>
+#include<type_traits>
+#include<stdexcept>
+#include"record_store.h"
+#include"thread_pool.h"
+using namespace std;
+
+//选择位图，第i位表示第i行是否被选中，可以按位与、或后计数
+class Bitmap
+{
+	vector<uint64_t> words;
+	size_t bits = 0;
+
+	//清除最后一个字中超出范围的位
+	void trim()
+	{
+		if (bits % 64 != 0 && !words.empty()) words.back() &= (1ull << (bits % 64)) - 1;
+	}
+public:
+	Bitmap() {}
+	//形参：位数，初始值
+	Bitmap(size_t bits, bool value = false) : words((bits + 63) / 64, value ? ~0ull : 0), bits(bits)
+	{
+		trim();
+	}
+
+	size_t Size() const { return bits; }
+	bool Test(size_t i) const { return (words[i / 64] >> (i % 64)) & 1; }
+	void Set(size_t i) { words[i / 64] |= 1ull << (i % 64); }
+	void Reset(size_t i) { words[i / 64] &= ~(1ull << (i % 64)); }
+	//第w个字，用于并行写入：不同任务写不同的字互不影响
+	uint64_t& Word(size_t w) { return words[w]; }
+
+	//与另一位图求交，位数不同时截断到较短的位数（超出部分在较短的一方中视为未选中）
+	Bitmap& And(const Bitmap& other)
+	{
+		if (other.bits < bits)
+		{
+			bits = other.bits;
+			words.resize((bits + 63) / 64);
+			trim();
+		}
+		for (size_t i = 0; i < words.size(); i++) words[i] &= other.words[i];
+		return *this;
+	}
+	//与另一位图求并，位数不同时较短的一方补0扩展到较长的位数
+	Bitmap& Or(const Bitmap& other)
+	{
+		if (other.bits > bits)
+		{
+			bits = other.bits;
+			words.resize((bits + 63) / 64, 0);
+		}
+		for (size_t i = 0; i < other.words.size(); i++) words[i] |= other.words[i];
+		return *this;
+	}
+	//取反
+	Bitmap& Not()
+	{
+		for (auto& w : words) w = ~w;
+		trim();
+		return *this;
+	}
+	Bitmap operator&(const Bitmap& other) const { return Bitmap(*this).And(other); }
+	Bitmap operator|(const Bitmap& other) const { return Bitmap(*this).Or(other); }
+	Bitmap operator~() const { return Bitmap(*this).Not(); }
+
+	//被选中的行数
+	size_t Count() const
+	{
+		size_t n = 0;
+		for (auto w : words) n += bitset<64>(w).count();
+		return n;
+	}
+	//按顺序遍历被选中的行，f(行号)
+	template<typename F>
+	void ForEach(F f) const
+	{
+		for (size_t i = 0; i < words.size(); i++)
+		{
+			uint64_t w = words[i];
+			while (w != 0)
+			{
+				size_t bit = 0;
+				while (((w >> bit) & 1) == 0) bit++;
+				f(i * 64 + bit);
+				w &= w - 1;
+			}
+		}
+	}
+};
+
+//查询结果视图，只保存被选中的记录指针，提供Size()和At(i)，可以直接交给GirdList::SetSource
+template<typename T>
+class QueryView
+{
+	vector<T*> rows;
+public:
+	QueryView() {}
+	QueryView(vector<T*>&& rows) : rows(std::move(rows)) {}
+	size_t Size() { return rows.size(); }
+	T* At(size_t i) { return rows[i]; }
+};
+
+/// <summary>
+/// 记录容器上的多条件查询。查询前先声明要参与过滤的列，列值被抽取到连续的数组中缓存，
+/// 容器版本变化后才重新抽取。每个条件在线程池上分块扫描对应的列并产生位图，条件之间用位图的与、或组合：
+/// auto credit = query.AddColumn(&Course::credit);
+/// auto teacher = query.AddColumn(&Course::teacher);
+/// view = query.View(query.Range(*credit, 2, 4).And(query.Equals(*teacher, string("张三"))));
+/// 记录被直接修改后需要调用容器的Touch，否则缓存不会更新
+/// </summary>
+template<typename T>
+class RecordQuery
+{
+	static const size_t blockRows = 64 * 256;  //每个扫描任务处理的行数，是64的倍数，任务之间不会写同一个字
+
+	//列缓存的公共接口
+	struct IColumn
+	{
+		virtual void Refresh(const vector<T*>& rows) = 0;
+		virtual ~IColumn() {}
+	};
+public:
+	//一列的缓存值，按行号排列
+	template<typename M>
+	class Column : public IColumn
+	{
+		friend class RecordQuery;
+		//vector<bool>按位存放，并行写入会互相覆盖，bool按字节存放
+		typedef typename conditional<is_same<M, bool>::value, unsigned char, M>::type Stored;
+		function<M(const T&)> extract;
+		vector<Stored> values;
+	public:
+		Column(function<M(const T&)> extract) : extract(extract) {}
+		void Refresh(const vector<T*>& rows) override
+		{
+			values.resize(rows.size());
+			size_t blocks = (rows.size() + blockRows - 1) / blockRows;
+			ThreadPool::Shared().ParallelFor(blocks, [&](size_t b)
+				{
+					size_t end = min(rows.size(), (b + 1) * blockRows);
+					for (size_t i = b * blockRows; i < end; i++) values[i] = extract(*rows[i]);
+				});
+		}
+		const vector<Stored>& Values() { return values; }
+	};
+private:
+	RecordStore<T>& store;
+	vector<T*> rows;  //按插入顺序的记录，行号即下标
+	vector<shared_ptr<IColumn>> columns;
+	uint64_t version = 0;
+	bool built = false;
+
+	//容器变化后重建行表和全部列缓存
+	void refresh()
+	{
+		if (built && version == store.Version()) return;
+		rows.clear();
+		rows.reserve(store.Size());
+		store.ForEach([this](RecordHandle, T& t) {rows.push_back(&t); });
+		for (auto& c : columns) c->Refresh(rows);
+		version = store.Version();
+		built = true;
+	}
+public:
+	RecordQuery(RecordStore<T>& store) : store(store) {}
+
+#pragma region 列
+	//声明一列，返回的列对象用于构造条件
+	template<typename M>
+	shared_ptr<Column<M>> AddColumn(function<M(const T&)> extract)
+	{
+		auto column = make_shared<Column<M>>(extract);
+		if (built) column->Refresh(rows);
+		columns.push_back(column);
+		return column;
+	}
+	//以成员作为一列
+	template<typename M>
+	shared_ptr<Column<M>> AddColumn(M T::* member)
+	{
+		return AddColumn<M>([member](const T& t) {return t.*member; });
+	}
+#pragma endregion
+
+#pragma region 条件
+	//当前行数
+	size_t Size()
+	{
+		refresh();
+		return rows.size();
+	}
+	//全部行
+	Bitmap All()
+	{
+		return Bitmap(Size(), true);
+	}
+	//并行扫描一列，pred(const M&)为true的行被选中
+	template<typename M, typename P>
+	Bitmap Scan(Column<M>& column, P pred)
+	{
+		refresh();
+		const auto& values = column.values;
+		Bitmap result(values.size());
+		size_t blocks = (values.size() + blockRows - 1) / blockRows;
+		ThreadPool::Shared().ParallelFor(blocks, [&](size_t b)
+			{
+				size_t end = min(values.size(), (b + 1) * blockRows);
+				for (size_t w = b * blockRows; w < end; w += 64)
+				{
+					uint64_t bits = 0;
+					size_t n = min((size_t)64, end - w);
+					for (size_t i = 0; i < n; i++) bits |= (uint64_t)(pred(values[w + i]) ? 1 : 0) << i;
+					result.Word(w / 64) = bits;
+				}
+			});
+		return result;
+	}
+	//lo <= 值 <= hi
+	template<typename M>
+	Bitmap Range(Column<M>& column, const M& lo, const M& hi)
+	{
+		return Scan(column, [&lo, &hi](const M& v) {return !(v < lo) && !(hi < v); });
+	}
+	//值 == value
+	template<typename M>
+	Bitmap Equals(Column<M>& column, const M& value)
+	{
+		return Scan(column, [&value](const M& v) {return v == value; });
+	}
+	//值在给定集合中
+	template<typename M>
+	Bitmap In(Column<M>& column, const vector<M>& set)
+	{
+		return Scan(column, [&set](const M& v)
+			{
+				for (auto& i : set) if (v == i) return true;
+				return false;
+			});
+	}
+#pragma endregion
+
+#pragma region 结果
+	//按位图选出记录，得到的视图在容器删除其中记录前有效。
+	//位图的位数需要等于当前行数，容器增删记录后旧的位图不再对应行号，需要重新生成，否则抛出invalid_argument
+	QueryView<T> View(const Bitmap& selection)
+	{
+		refresh();
+		if (selection.Size() != rows.size())
+			throw invalid_argument("位图有" + to_string(selection.Size()) + "位，当前有" + to_string(rows.size()) + "行，容器变化后需要重新生成位图");
+		vector<T*> result;
+		result.reserve(selection.Count());
+		selection.ForEach([&](size_t i) {result.push_back(rows[i]); });
+		return QueryView<T>(std::move(result));
+	}
+	//第i行的记录
+	T* Row(size_t i)
+	{
+		refresh();
+		return rows[i];
+	}
+#pragma endregion
+};
@@ -0,0 +1,288 @@
+﻿#pragma once
+#include<vector>
+#include<memory>
+#include<new>
+#include<cstdint>
+#include<cassert>
+#include<type_traits>
+#include<utility>
+using namespace std;
+
+//记录句柄，记录被删除或容器被清空后旧句柄自动失效
+struct RecordHandle
+{
+	uint32_t index = 0xFFFFFFFF;  //槽位
+	uint32_t generation = 0;  //槽位被复用的次数
+
+	bool Valid() const { return index != 0xFFFFFFFF; }
+	bool operator==(const RecordHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const RecordHandle& other) const { return !(*this == other); }
+};
+
+//记录容器的索引接口，容器在增删改时通知所有已挂接的索引
+template<typename T>
+class IRecordIndex
+{
+public:
+	//value能否以self的身份加入索引（唯一索引检查主键冲突），self为无效句柄表示新记录
+	virtual bool CanInsert(const T& value, RecordHandle self) = 0;
+	//记录加入容器后调用
+	virtual void OnInsert(RecordHandle h, const T& value) = 0;
+	//记录离开容器前调用
+	virtual void OnErase(RecordHandle h, const T& value) = 0;
+	//容器被清空时调用
+	virtual void OnClear() = 0;
+	virtual ~IRecordIndex() {}
+};
+
+/// <summary>
+/// 记录容器，记录按块连续存放在池中，地址与句柄在记录被删除前保持不变。
+/// 容器拥有记录的内存，析构或Release时统一释放，不再需要逐个delete
+/// </summary>
+template<typename T>
+class RecordStore
+{
+	static const uint32_t chunkSize = 1024;  //每块容纳的记录数
+	struct Slot
+	{
+		alignas(T) unsigned char storage[sizeof(T)];
+		uint32_t generation;
+		bool alive;
+	};
+	vector<unique_ptr<Slot[]>> chunks;  //记录池
+	uint32_t slotCount = 0;  //已经使用过的槽位数
+	uint32_t generationSeed = 1;  //新块中槽位的初始代数，保证Release前的句柄不会误命中
+	vector<uint32_t> freeSlots;  //可复用的槽位
+	vector<uint32_t> pendingFree;  //已删除但仍留在order中的槽位，压缩后才能复用
+	vector<uint32_t> order;  //按插入顺序排列的槽位，删除时只做标记，访问时再压缩
+	size_t dead = 0;  //order中已删除的槽位数
+	size_t live = 0;  //存活记录数
+	vector<IRecordIndex<T>*> indexes;  //挂接的索引，不持有
+	uint64_t version = 0;  //内容版本，每次增删改后递增
+
+	Slot& slot(uint32_t index) { return chunks[index / chunkSize][index % chunkSize]; }
+	T* object(Slot& s) { return reinterpret_cast<T*>(s.storage); }
+
+	//新增一块槽位
+	void add_chunk()
+	{
+		chunks.emplace_back(new Slot[chunkSize]);
+		for (uint32_t i = 0; i < chunkSize; i++)
+		{
+			chunks.back()[i].generation = generationSeed;
+			chunks.back()[i].alive = false;
+		}
+	}
+	//分配一个槽位并推进代数
+	uint32_t allocate()
+	{
+		uint32_t index;
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			if (slotCount == chunks.size() * chunkSize) add_chunk();
+			index = slotCount++;
+		}
+		Slot& s = slot(index);
+		s.generation++;
+		if (s.generation >= generationSeed) generationSeed = s.generation + 1;
+		return index;
+	}
+	//去掉order中已删除的槽位
+	void compact()
+	{
+		if (dead == 0) return;
+		size_t n = 0;
+		for (size_t i = 0; i < order.size(); i++)
+			if (slot(order[i]).alive) order[n++] = order[i];
+		order.resize(n);
+		dead = 0;
+		freeSlots.insert(freeSlots.end(), pendingFree.begin(), pendingFree.end());
+		pendingFree.clear();
+	}
+	//析构全部存活记录
+	void destroy_all()
+	{
+		if constexpr (!is_trivially_destructible<T>::value)
+		{
+			for (auto i : order)
+			{
+				Slot& s = slot(i);
+				if (s.alive) object(s)->~T();
+			}
+		}
+	}
+public:
+	RecordStore() {}
+	RecordStore(const RecordStore&) = delete;
+	RecordStore& operator=(const RecordStore&) = delete;
+	~RecordStore()
+	{
+		destroy_all();
+	}
+
+#pragma region 增删查
+	//在容器内构造一条记录并返回句柄，违反唯一索引时不插入并返回无效句柄
+	template<typename... Args>
+	RecordHandle Emplace(Args&&... args)
+	{
+		uint32_t index = allocate();
+		Slot& s = slot(index);
+		T* t = new (s.storage) T(std::forward<Args>(args)...);
+		for (auto i : indexes)
+		{
+			if (!i->CanInsert(*t, RecordHandle{}))
+			{
+				//槽位还未进入order，可以直接复用
+				t->~T();
+				freeSlots.push_back(index);
+				return RecordHandle{};
+			}
+		}
+		s.alive = true;
+		order.push_back(index);
+		live++;
+		version++;
+		RecordHandle h{ index,s.generation };
+		for (auto i : indexes) i->OnInsert(h, *t);
+		return h;
+	}
+	RecordHandle Insert(const T& value) { return Emplace(value); }
+	RecordHandle Insert(T&& value) { return Emplace(std::move(value)); }
+
+	//通过句柄获取记录，句柄失效时返回nullptr
+	T* Get(RecordHandle h)
+	{
+		if (h.index >= slotCount) return nullptr;
+		Slot& s = slot(h.index);
+		if (!s.alive || s.generation != h.generation) return nullptr;
+		return object(s);
+	}
+	//删除记录，槽位留给之后的插入复用
+	bool Erase(RecordHandle h)
+	{
+		T* t = Get(h);
+		if (t == nullptr) return false;
+		for (auto i : indexes) i->OnErase(h, *t);
+		t->~T();
+		slot(h.index).alive = false;
+		pendingFree.push_back(h.index);
+		dead++;
+		live--;
+		version++;
+		return true;
+	}
+	//整体替换一条记录并同步索引，句柄失效或违反唯一索引时返回false且记录不变
+	bool Update(RecordHandle h, const T& value)
+	{
+		T* t = Get(h);
+		if (t == nullptr) return false;
+		for (auto i : indexes) if (!i->CanInsert(value, h)) return false;
+		for (auto i : indexes) i->OnErase(h, *t);
+		*t = value;
+		for (auto i : indexes) i->OnInsert(h, *t);
+		version++;
+		return true;
+	}
+	bool Update(RecordHandle h, T&& value)
+	{
+		T* t = Get(h);
+		if (t == nullptr) return false;
+		for (auto i : indexes) if (!i->CanInsert(value, h)) return false;
+		for (auto i : indexes) i->OnErase(h, *t);
+		*t = std::move(value);
+		for (auto i : indexes) i->OnInsert(h, *t);
+		version++;
+		return true;
+	}
+#pragma endregion
+
+#pragma region 索引
+	//挂接索引并用现有记录建立索引，由索引的构造函数调用
+	void Attach(IRecordIndex<T>* index)
+	{
+		indexes.push_back(index);
+		ForEach([index](RecordHandle h, T& value) {index->OnInsert(h, value); });
+	}
+	//解除索引挂接，由索引的析构函数调用
+	void Detach(IRecordIndex<T>* index)
+	{
+		for (auto i = indexes.begin(); i != indexes.end(); i++)
+		{
+			if (*i == index)
+			{
+				indexes.erase(i);
+				return;
+			}
+		}
+	}
+#pragma endregion
+
+#pragma region 顺序访问
+	//存活记录数
+	size_t Size() { return live; }
+	//内容版本，缓存据此判断是否需要重建
+	uint64_t Version() { return version; }
+	//通过Get或At直接修改记录后调用，使依赖版本的缓存失效
+	void Touch() { version++; }
+	//按插入顺序的第i条记录
+	T* At(size_t i)
+	{
+		compact();
+		return object(slot(order[i]));
+	}
+	//按插入顺序的第i条记录的句柄
+	RecordHandle HandleAt(size_t i)
+	{
+		compact();
+		return { order[i],slot(order[i]).generation };
+	}
+	//按插入顺序遍历，f(RecordHandle, T&)
+	template<typename F>
+	void ForEach(F f)
+	{
+		compact();
+		for (auto i : order)
+		{
+			Slot& s = slot(i);
+			f(RecordHandle{ i,s.generation }, *object(s));
+		}
+	}
+	//预留空间，避免批量导入时反复分配块
+	void Reserve(size_t count)
+	{
+		order.reserve(count);
+		while (chunks.size() * chunkSize < count) add_chunk();
+	}
+#pragma endregion
+
+#pragma region 批量释放
+	//删除全部记录但保留内存，平凡析构的记录类型为O(1)
+	void Clear()
+	{
+		destroy_all();
+		//槽位代数保留在池中，重新分配时继续递增，旧句柄自然失效
+		slotCount = 0;
+		freeSlots.clear();
+		pendingFree.clear();
+		order.clear();
+		dead = 0;
+		live = 0;
+		version++;
+		for (auto i : indexes) i->OnClear();
+	}
+	//删除全部记录并把内存还给系统，开销只与块数有关
+	void Release()
+	{
+		Clear();
+		chunks.clear();
+		chunks.shrink_to_fit();
+		order.shrink_to_fit();
+		freeSlots.shrink_to_fit();
+	}
+#pragma endregion
+};
@@ -0,0 +1,278 @@
+﻿#pragma once
+#include<string>
+#include<string_view>
+#include<vector>
+#include<tuple>
+#include<charconv>
+#include<stdexcept>
+#include<type_traits>
+#include<functional>
+#include"csvfile.h"
+using namespace std;
+
+//字段描述：列名与成员指针
+template<typename T, typename M>
+struct SchemaField
+{
+	const char* name;
+	M T::* member;
+};
+
+//声明一个字段，用于记录类型的Schema()
+template<typename T, typename M>
+constexpr SchemaField<T, M> Field(const char* name, M T::* member)
+{
+	return { name,member };
+}
+
+//字段值与文本、快照之间的转换，支持整数、bool、浮点数和string
+struct SchemaCodec
+{
+	//把值格式化追加到out，字符串按原样追加
+	template<typename M>
+	static void Append(string& out, const M& value)
+	{
+		if constexpr (is_same<M, string>::value) out += value;
+		else if constexpr (is_same<M, bool>::value) out += value ? '1' : '0';
+		else if constexpr (is_arithmetic<M>::value)
+		{
+			char temp[64];
+			auto r = to_chars(temp, temp + sizeof(temp), value);
+			out.append(temp, r.ptr);
+		}
+		else static_assert(is_same<M, string>::value, "Schema字段只支持整数、bool、浮点数和string");
+	}
+	//按csv规则追加，包含逗号、引号或换行的字符串加引号并转义
+	template<typename M>
+	static void AppendCsv(string& out, const M& value)
+	{
+		if constexpr (is_same<M, string>::value)
+		{
+			if (value.find_first_of(",\"\r\n") == string::npos)
+			{
+				out += value;
+				return;
+			}
+			out += '"';
+			for (char c : value)
+			{
+				if (c == '"') out += '"';
+				out += c;
+			}
+			out += '"';
+		}
+		else Append(out, value);
+	}
+	//从文本解析值，格式错误或有多余字符时返回false且不修改value
+	template<typename M>
+	static bool Parse(string_view text, M& value)
+	{
+		if constexpr (is_same<M, string>::value)
+		{
+			value.assign(text.data(), text.size());
+			return true;
+		}
+		else if constexpr (is_same<M, bool>::value)
+		{
+			if (text == "1" || text == "true") value = true;
+			else if (text == "0" || text == "false") value = false;
+			else return false;
+			return true;
+		}
+		else if constexpr (is_arithmetic<M>::value)
+		{
+			M temp{};
+			const char* end = text.data() + text.size();
+			auto r = from_chars(text.data(), end, temp);
+			if (r.ec != errc() || r.ptr != end) return false;
+			value = temp;
+			return true;
+		}
+		else static_assert(is_same<M, string>::value, "Schema字段只支持整数、bool、浮点数和string");
+	}
+	//写入快照的第col列
+	template<typename M>
+	static void Write(SnapshotWriter& writer, int col, const M& value)
+	{
+		if constexpr (is_same<M, string>::value) writer.String(col, value);
+		else if constexpr (is_floating_point<M>::value) writer.Double(col, value);
+		else writer.Int(col, (int64_t)value);
+	}
+	//从快照的第col列读取
+	template<typename M>
+	static void Read(const SnapshotReader& reader, int col, size_t row, M& value)
+	{
+		if constexpr (is_same<M, string>::value) value.assign(reader.String(col, row));
+		else if constexpr (is_same<M, bool>::value) value = reader.Int(col, row) != 0;
+		else if constexpr (is_floating_point<M>::value) value = (M)reader.Double(col, row);
+		else value = (M)reader.Int(col, row);
+	}
+	//把快照第col列整体读入各记录的member，按列顺序访问连续数组
+	template<typename R, typename M>
+	static void ReadColumn(const SnapshotReader& reader, int col, const vector<R*>& rows, M R::* member)
+	{
+		size_t n = rows.size();
+		if constexpr (is_same<M, string>::value)
+		{
+			const uint64_t* offsets = reader.Offsets(col);
+			const char* chars = reader.Chars(col);
+			for (size_t i = 0; i < n; i++) (rows[i]->*member).assign(chars + offsets[i], (size_t)(offsets[i + 1] - offsets[i]));
+		}
+		else if constexpr (is_floating_point<M>::value)
+		{
+			const double* values = reader.Doubles(col);
+			for (size_t i = 0; i < n; i++) rows[i]->*member = (M)values[i];
+		}
+		else
+		{
+			const int64_t* values = reader.Ints(col);
+			for (size_t i = 0; i < n; i++)
+			{
+				if constexpr (is_same<M, bool>::value) rows[i]->*member = values[i] != 0;
+				else rows[i]->*member = (M)values[i];
+			}
+		}
+	}
+};
+
+//逐字段读取一行csv，引号内的逗号和换行属于字段内容，""表示一个引号
+class CsvCursor
+{
+	string_view row;
+	size_t pos = 0;
+	bool ended = false;
+	string scratch;  //带引号字段反转义后的内容
+public:
+	CsvCursor(string_view row) : row(row) {}
+	//读取下一个字段，没有更多字段时返回false
+	bool Next(string_view& field)
+	{
+		if (ended) return false;
+		if (pos < row.size() && row[pos] == '"')
+		{
+			scratch.clear();
+			pos++;
+			while (pos < row.size())
+			{
+				if (row[pos] == '"')
+				{
+					if (pos + 1 < row.size() && row[pos + 1] == '"')
+					{
+						scratch += '"';
+						pos += 2;
+						continue;
+					}
+					pos++;
+					break;
+				}
+				scratch += row[pos++];
+			}
+			field = scratch;
+		}
+		else
+		{
+			size_t end = row.find(',', pos);
+			if (end == string_view::npos) end = row.size();
+			field = row.substr(pos, end - pos);
+			pos = end;
+		}
+		if (pos < row.size() && row[pos] == ',') pos++;
+		else ended = true;
+		return true;
+	}
+};
+
+/// <summary>
+/// 由字段表生成序列化代码的记录基类。记录类型只需声明一次字段：
+/// static auto Schema() { return make_tuple(Field("编号", &Course::id), Field("名称", &Course::name)); }
+/// csv读写、二进制快照和GirdList列定义都由同一份字段表生成
+/// </summary>
+template<typename T>
+class SchemaRecord : public ISerializable<T>, public ISnapshotRecord
+{
+	T& self() { return static_cast<T&>(*this); }
+public:
+	string ToCsvRow() override
+	{
+		string row;
+		AppendCsvRow(row);
+		return row;
+	}
+	//直接格式化到输出缓冲区，不产生中间字符串
+	void AppendCsvRow(string& out) override
+	{
+		bool first = true;
+		apply([&](const auto&... f)
+			{
+				((out += first ? "" : ",", first = false, SchemaCodec::AppendCsv(out, self().*(f.member))), ...);
+			}, T::Schema());
+	}
+	//字段缺失或格式错误时抛出invalid_argument，csvfile会把它记录为该行的错误
+	void FromCsvRow(string str) override
+	{
+		CsvCursor cursor(str);
+		apply([&](const auto&... f)
+			{
+				(ParseField(cursor, f.name, self().*(f.member)), ...);
+			}, T::Schema());
+	}
+	void ToSnapshot(SnapshotWriter& writer) override
+	{
+		int col = 0;
+		apply([&](const auto&... f)
+			{
+				(SchemaCodec::Write(writer, col++, self().*(f.member)), ...);
+			}, T::Schema());
+	}
+	void FromSnapshot(const SnapshotReader& reader, size_t row) override
+	{
+		int col = 0;
+		apply([&](const auto&... f)
+			{
+				(SchemaCodec::Read(reader, col++, row, self().*(f.member)), ...);
+			}, T::Schema());
+	}
+	//按列整体读取快照，rows已按快照行数创建
+	static void FromSnapshotColumns(const SnapshotReader& reader, const vector<T*>& rows)
+	{
+		int col = 0;
+		apply([&](const auto&... f)
+			{
+				(SchemaCodec::ReadColumn(reader, col++, rows, f.member), ...);
+			}, T::Schema());
+	}
+private:
+	template<typename M>
+	static void ParseField(CsvCursor& cursor, const char* name, M& value)
+	{
+		string_view field;
+		if (!cursor.Next(field)) throw invalid_argument(string("缺少字段 ") + name);
+		if (!SchemaCodec::Parse(field, value)) throw invalid_argument(string("字段格式错误 ") + name);
+	}
+};
+
+//GirdList表头，按字段表顺序
+template<typename T>
+vector<string> SchemaHeader()
+{
+	vector<string> head;
+	apply([&](const auto&... f) {(head.push_back(f.name), ...); }, T::Schema());
+	return head;
+}
+
+//GirdList列函数，按字段表顺序显示每个字段
+template<typename T>
+function<vector<string>(T*)> SchemaColumns()
+{
+	return [](T* t)
+		{
+			vector<string> row;
+			apply([&](const auto&... f)
+				{
+					row.resize(sizeof...(f));
+					size_t i = 0;
+					(SchemaCodec::Append(row[i++], t->*(f.member)), ...);
+				}, T::Schema());
+			return row;
+		};
+}
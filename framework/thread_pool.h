@@ -0,0 +1,124 @@
+﻿#pragma once
+#include<vector>
+#include<queue>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+#include<future>
+#include<memory>
+using namespace std;
+
+//线程池，框架内所有后台任务（并行读取、并行扫描、异步保存等）都投递到这里执行
+class ThreadPool
+{
+private:
+	vector<thread> workers;  //工作线程
+	queue<function<void(void)>> tasks;  //待执行任务
+	mutex lock;  //任务队列锁
+	condition_variable wake;  //唤醒工作线程
+	bool stop = false;  //是否正在关闭
+
+	//当前线程所属的线程池，不是工作线程时为nullptr
+	static ThreadPool*& current()
+	{
+		static thread_local ThreadPool* pool = nullptr;
+		return pool;
+	}
+
+	//工作线程主循环
+	void WorkLoop()
+	{
+		current() = this;
+		while (true)
+		{
+			function<void(void)> task;
+			{
+				unique_lock<mutex> guard(lock);
+				wake.wait(guard, [this]() {return stop || !tasks.empty(); });
+				if (stop && tasks.empty()) return;
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+			task();
+		}
+	}
+public:
+	//形参：线程数量，小于等于0时使用硬件线程数
+	ThreadPool(int count = 0)
+	{
+		if (count <= 0) count = (int)thread::hardware_concurrency();
+		if (count <= 0) count = 1;
+		for (int i = 0; i < count; i++)
+			workers.emplace_back([this]() {WorkLoop(); });
+	}
+	//等待已投递的任务全部完成后回收线程
+	~ThreadPool()
+	{
+		{
+			lock_guard<mutex> guard(lock);
+			stop = true;
+		}
+		wake.notify_all();
+		for (auto& i : workers) i.join();
+	}
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	//线程数量
+	int Size() { return (int)workers.size(); }
+
+	//投递任务，返回可等待结果的future
+	template<typename F>
+	auto Submit(F func) -> future<decltype(func())>
+	{
+		using R = decltype(func());
+		auto task = make_shared<packaged_task<R(void)>>(std::move(func));
+		future<R> result = task->get_future();
+		{
+			lock_guard<mutex> guard(lock);
+			tasks.push([task]() {(*task)(); });
+		}
+		wake.notify_one();
+		return result;
+	}
+
+	//当前线程是否为本线程池的工作线程
+	bool InWorker() { return current() == this; }
+
+	//把[0,count)分给线程池并行执行并等待全部完成。
+	//在本线程池的任务内调用时直接在当前线程依次执行，否则工作线程全部在等待时无人执行子任务而死锁
+	void ParallelFor(size_t count, function<void(size_t)> body)
+	{
+		if (InWorker())
+		{
+			for (size_t i = 0; i < count; i++) body(i);
+			return;
+		}
+		vector<future<void>> waits;
+		waits.reserve(count);
+		for (size_t i = 0; i < count; i++)
+			waits.push_back(Submit([&body, i]() {body(i); }));
+		//先等全部任务结束再抛出异常，避免任务引用已销毁的body
+		exception_ptr error = nullptr;
+		for (auto& i : waits)
+		{
+			try { i.get(); }
+			catch (...) { if (error == nullptr) error = current_exception(); }
+		}
+		if (error != nullptr) rethrow_exception(error);
+	}
+
+	//框架共享的线程池
+	static ThreadPool& Shared()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+	//加载线程，用于节点异步进入等整段的后台加载。加载函数内的并行读取、并行扫描仍分给Shared()执行，不会互相等待
+	static ThreadPool& Loader()
+	{
+		static ThreadPool pool(2);
+		return pool;
+	}
+};
@@ -6,7 +6,16 @@
 #include <fstream>
 #include <sys/stat.h>
 #include<filesystem>
+#include<cstdint>
+#include<cerrno>
+#include<atomic>
+#ifdef _WIN32
 #include<Windows.h>
+#else
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#endif
 using namespace std;
 
 
@@ -30,8 +39,11 @@ inline bool checkPathExists(const std::string& path) {
 }
 
 inline bool createDirectory(const std::string& directoryPath) {
-    int status = CreateDirectory(directoryPath.c_str(), NULL);
-    return (status == 0);
+#ifdef _WIN32
+    return CreateDirectory(directoryPath.c_str(), NULL) != 0;
+#else
+    return mkdir(directoryPath.c_str(), 0755) == 0;
+#endif
 }
 
 inline void createFileIfNotExists(const std::string& filePath) {
@@ -58,6 +70,11 @@ inline void createPathIfNotExists(const std::string& path) {
     std::string currentPath = "";
 
     while (std::getline(iss, directory, '/')) {
+        // 绝对路径开头或连续的'/'
+        if (directory.empty()) {
+            currentPath += "/";
+            continue;
+        }
         currentPath += directory;
         if (!checkPathExists(currentPath)) {
             if (createDirectory(currentPath)) {
@@ -78,16 +95,288 @@ inline void createPathIfNotExists(const std::string& path) {
 inline void checkAndCreatePathAndFile(const std::string& filePath) {
     // 获取目录路径
     size_t lastSlashPos = filePath.find_last_of('/');
-    std::string directoryPath = filePath.substr(0, lastSlashPos);
 
-    // 检查并创建目录
-    createPathIfNotExists(directoryPath);
+    // 检查并创建目录，没有目录部分时文件在当前目录下
+    if (lastSlashPos != std::string::npos && lastSlashPos > 0)
+        createPathIfNotExists(filePath.substr(0, lastSlashPos));
 
     // 检查并创建文件
     createFileIfNotExists(filePath);
 }
 
+#ifdef _WIN32
+typedef HANDLE NativeFile;
+inline const NativeFile invalidFile = INVALID_HANDLE_VALUE;
+#else
+typedef int NativeFile;
+inline const NativeFile invalidFile = -1;
+#endif
+
+//打开文件用于写入，append为true时追加到末尾，否则清空
+inline NativeFile openFileForWrite(const string& path, bool append)
+{
+#ifdef _WIN32
+    return CreateFile(path.c_str(), append ? FILE_APPEND_DATA : GENERIC_WRITE, append ? FILE_SHARE_READ : 0, NULL,
+        append ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0644);
+#endif
+}
 
+//写入全部数据
+inline bool writeFileAll(NativeFile file, const char* data, size_t size)
+{
+    size_t done = 0;
+    while (done < size)
+    {
+#ifdef _WIN32
+        DWORD wrote = 0;
+        DWORD part = (DWORD)min(size - done, (size_t)(1 << 30));
+        if (!WriteFile(file, data + done, part, &wrote, NULL)) return false;
+#else
+        ssize_t wrote = write(file, data + done, min(size - done, (size_t)(1 << 30)));
+        if (wrote < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+#endif
+        done += (size_t)wrote;
+    }
+    return true;
+}
+
+//把文件内容刷到磁盘
+inline bool syncFile(NativeFile file)
+{
+#ifdef _WIN32
+    return FlushFileBuffers(file) != 0;
+#else
+    return fsync(file) == 0;
+#endif
+}
+
+inline void closeFile(NativeFile file)
+{
+#ifdef _WIN32
+    CloseHandle(file);
+#else
+    close(file);
+#endif
+}
+
+//用from整体替换to，替换本身也刷盘
+inline bool replaceFile(const string& from, const string& to)
+{
+#ifdef _WIN32
+    return MoveFileEx(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (rename(from.c_str(), to.c_str()) != 0) return false;
+    //目录项也需要刷盘，否则断电后可能仍是旧文件
+    size_t slash = to.find_last_of('/');
+    string dir = slash == string::npos ? "." : (slash == 0 ? "/" : to.substr(0, slash));
+    int fd = open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+    return true;
+#endif
+}
+
+//目标文件对应的临时文件名，带进程号与进程内计数，
+//同一路径上同时存在的多个写入器（如后台保存与前台保存）各写各的临时文件，不会互相覆盖或删除
+inline string uniqueTempPath(const string& path)
+{
+    static atomic<uint64_t> counter{ 0 };
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    return path + "." + to_string(pid) + "." + to_string(++counter) + ".tmp";
+}
+
+//带缓冲的原子写入器：内容先写入临时文件，提交时刷盘再整体替换目标文件，
+//中途崩溃时目标文件要么是旧内容要么是新内容
+class AtomicFileWriter
+{
+    string target;  //目标文件
+    string temp;  //临时文件
+    string& buffer;  //外部提供的缓冲区，由调用者复用
+    NativeFile file = invalidFile;
+    bool committed = false;
+public:
+    //形参：目标路径，缓冲区（写入前会被清空，容量保留）
+    AtomicFileWriter(const string& path, string& buf) : target(path), temp(uniqueTempPath(path)), buffer(buf)
+    {
+        buffer.clear();
+    }
+    ~AtomicFileWriter()
+    {
+        if (!committed) Abort();
+    }
+    //创建临时文件
+    bool Open()
+    {
+        file = openFileForWrite(temp, false);
+        return file != invalidFile;
+    }
+    //把缓冲区内容写入临时文件并清空缓冲区
+    bool Flush()
+    {
+        if (file == invalidFile) return false;
+        if (!writeFileAll(file, buffer.data(), buffer.size())) return false;
+        buffer.clear();
+        return true;
+    }
+    //刷盘并替换目标文件
+    bool Commit()
+    {
+        if (!Flush() || !syncFile(file)) return false;
+        closeFile(file);
+        file = invalidFile;
+        if (!replaceFile(temp, target)) return false;
+        committed = true;
+        return true;
+    }
+    //放弃写入并删除临时文件
+    void Abort()
+    {
+        if (file != invalidFile) closeFile(file);
+        file = invalidFile;
+        remove(temp.c_str());
+    }
+};
+
+//把数据追加到文件末尾并刷盘
+inline bool appendFileDurable(const string& path, const string& data)
+{
+    NativeFile file = openFileForWrite(path, true);
+    if (file == invalidFile) return false;
+    bool ok = writeFileAll(file, data.data(), data.size()) && syncFile(file);
+    closeFile(file);
+    return ok;
+}
+
+//只读内存映射文件
+class MappedFile
+{
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int file = -1;
+#endif
+    const char* view = nullptr;
+    size_t size = 0;
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile()
+    {
+        Close();
+    }
+    //映射整个文件，空文件也视为成功
+    bool Open(const string& path)
+    {
+        Close();
+#ifdef _WIN32
+        file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER len;
+        if (!GetFileSizeEx(file, &len)) { Close(); return false; }
+        size = (size_t)len.QuadPart;
+        if (size == 0) return true;
+        mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) { Close(); return false; }
+        view = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr) { Close(); return false; }
+#else
+        file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file < 0) return false;
+        struct stat st;
+        if (fstat(file, &st) != 0) { Close(); return false; }
+        size = (size_t)st.st_size;
+        if (size == 0) return true;
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (p == MAP_FAILED) { Close(); return false; }
+        view = (const char*)p;
+#endif
+        return true;
+    }
+    void Close()
+    {
+#ifdef _WIN32
+        if (view != nullptr) UnmapViewOfFile(view);
+        if (mapping != NULL) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (view != nullptr) munmap((void*)view, size);
+        if (file >= 0) close(file);
+        file = -1;
+#endif
+        view = nullptr;
+        size = 0;
+    }
+    const char* Data() const { return view; }
+    size_t Size() const { return size; }
+};
+
+//FNV-1a 64位哈希，用于校验文件内容
+inline uint64_t hashBytes(const char* data, size_t len, uint64_t seed = 14695981039346656037ull)
+{
+    uint64_t h = seed;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+//目录变化通知，Open失败时调用者应退回到定时轮询
+#ifdef _WIN32
+class FileChangeNotifier
+{
+    HANDLE handle = INVALID_HANDLE_VALUE;
+public:
+    FileChangeNotifier() {}
+    FileChangeNotifier(const FileChangeNotifier&) = delete;
+    FileChangeNotifier& operator=(const FileChangeNotifier&) = delete;
+    ~FileChangeNotifier()
+    {
+        if (handle != INVALID_HANDLE_VALUE) FindCloseChangeNotification(handle);
+    }
+    //监听目录内文件的写入、大小和名称变化
+    bool Open(const string& directory)
+    {
+        handle = FindFirstChangeNotification(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_FILE_NAME);
+        return handle != INVALID_HANDLE_VALUE;
+    }
+    //自上次调用以来目录是否发生过变化，不阻塞
+    bool Changed()
+    {
+        if (handle == INVALID_HANDLE_VALUE || WaitForSingleObject(handle, 0) != WAIT_OBJECT_0) return false;
+        FindNextChangeNotification(handle);
+        return true;
+    }
+};
+#else
+//非Windows平台没有目录变化通知，Open总是失败，调用者退回定时轮询
+class FileChangeNotifier
+{
+public:
+    bool Open(const string&) { return false; }
+    bool Changed() { return false; }
+};
+#endif
+
+#ifdef _WIN32
 // 打开文件选择窗口
 inline string OpenFileSelectionWindow() 
 {
@@ -108,4 +397,5 @@ inline string OpenFileSelectionWindow()
     else {
         return "";
     }
-}
\ No newline at end of file
+}
+#endif
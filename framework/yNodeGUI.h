@@ -1,3 +1,7 @@
 ﻿#pragma once
 #include"framework.h"
 #include"node_menu.h"
+#include"form.h"
+#include"layout.h"
+#include"observable_list.h"
+#include"node_task.h"